@@ -0,0 +1,60 @@
+#!/bin/sh
+#
+# herramientas/pruebas.sh
+#	Ejecuta las pruebas de rendimiento de usuario/prueba_*
+#
+# Arranca el minikernel una vez por prueba con MINIKERNEL_INIT apuntando
+# al programa de la prueba y saca, por cada una, una linea con el tiempo
+# real del anfitrion y otra por cada linea RESULTADO del programa, todas
+# en formato "prueba=<nombre> clave=valor ...". Conviene compilar antes
+# el nucleo con "make release" en minikernel/ para que los mensajes de
+# depuracion no falseen las medidas.
+#
+#	uso: herramientas/pruebas.sh [-p politica] [-t segundos] [prueba ...]
+#
+# Sin pruebas se ejecutan todas. La politica se pasa en MINIKERNEL_PLANIF
+# y -t limita lo que puede durar cada arranque (60 s por defecto). Se
+# puede llamar desde la raiz del sistema o desde herramientas/.
+#
+
+PRUEBAS="prueba_getpid prueba_crear prueba_pingpong prueba_dormir \
+	prueba_prio prueba_escribir"
+POLITICA=
+LIMITE=60
+
+while getopts p:t: opcion; do
+	case $opcion in
+	p) POLITICA=$OPTARG ;;
+	t) LIMITE=$OPTARG ;;
+	*) echo "uso: $0 [-p politica] [-t segundos] [prueba ...]" >&2; exit 2 ;;
+	esac
+done
+shift $((OPTIND - 1))
+[ $# -gt 0 ] && PRUEBAS="$*"
+
+cd "$(dirname "$0")/.." || exit 1
+if [ ! -x boot/boot ] || [ ! -f minikernel/kernel ]; then
+	echo "$0: falta compilar el sistema (make)" >&2
+	exit 1
+fi
+
+SALIDA=$(mktemp) || exit 1
+trap 'rm -f "$SALIDA"' EXIT
+
+# el simulador necesita un terminal, asi que se arranca bajo script
+for prueba in $PRUEBAS; do
+	if [ ! -f usuario/$prueba ]; then
+		echo "$0: no existe usuario/$prueba" >&2
+		continue
+	fi
+	inicio=$(date +%s%N)
+	MINIKERNEL_INIT=$prueba MINIKERNEL_PLANIF=$POLITICA timeout $LIMITE \
+		script -qc "./boot/boot ./minikernel/kernel" /dev/null \
+		< /dev/null > "$SALIDA" 2>&1
+	estado=$?
+	fin=$(date +%s%N)
+	echo "prueba=$prueba politica=${POLITICA:-defecto}" \
+		"estado=$estado anfitrion_ms=$(( (fin - inicio) / 1000000 ))"
+	tr -d '\r' < "$SALIDA" | sed -n \
+		's/^.*RESULTADO \([^ ]*\) \(.*\)$/prueba=\1 \2/p'
+done
@@ -0,0 +1,278 @@
+/*
+ *  herramientas/traza_chrome.c
+ *
+ */
+
+/*
+ *
+ * Programa del anfitrion que convierte el volcado de la traza del
+ * nucleo (lineas #H y #T de la salida del minikernel arrancado con
+ * MINIKERNEL_TRAZA) al formato JSON de eventos de traza de Chrome, que
+ * se puede abrir en chrome://tracing o en ui.perfetto.dev.
+ *
+ * Cada proceso tiene una pista con su estado (ejecucion, listo o
+ * bloqueado) y otra con sus llamadas al sistema; las interrupciones y
+ * las esperas del nucleo son eventos instantaneos en la pista del
+ * nucleo y los cambios de prioridad son contadores.
+ *
+ *	uso: traza_chrome [-s llamsis.h] [salida_minikernel] > traza.json
+ *
+ * Los nombres de las llamadas se leen de llamsis.h; por defecto se busca
+ * desde la raiz del sistema o desde herramientas/.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define VERSION_TRAZA 1
+
+#define MAX_PROCS 32768	/* los pid de la traza son short */
+#define MAX_LLAMADAS 64
+#define TAM_LINEA 512
+#define TAM_NOMBRE 32
+
+/* pistas de cada proceso y pid de Chrome del nucleo */
+#define PISTA_ESTADO 0
+#define PISTA_LLAMADAS 1
+#define PID_NUCLEO 0
+
+/* motivos de cambio de contexto, como en const.h */
+#define CC_FIN 0
+#define CC_BLOQUEO 1
+#define CC_REPLANIFICACION 2
+
+/* estados de un proceso en la traza */
+#define NINGUNO 0
+#define EJECUCION 1
+#define LISTO 2
+#define BLOQUEADO 3
+
+static char *nombres_estado[]={"", "ejecucion", "listo", "bloqueado"};
+
+typedef struct{
+	int conocido;		/* ha aparecido en la traza */
+	int estado;
+	unsigned long desde;	/* inicio del estado actual */
+	int en_llamada;		/* hay una llamada abierta */
+} proceso;
+
+static proceso procs[MAX_PROCS];
+static char nombres_llamada[MAX_LLAMADAS][TAM_NOMBRE];
+static int primer_evento = 1;
+static unsigned long ultimo_tiempo = 0;
+
+/*
+ * Lee los nombres de las llamadas de las lineas "#define NOMBRE numero"
+ * de llamsis.h
+ */
+static void leer_llamadas(char *fichero){
+	FILE *f;
+	char linea[TAM_LINEA], nombre[TAM_NOMBRE];
+	int num, i;
+
+	for (i=0; i<MAX_LLAMADAS; i++)
+		sprintf(nombres_llamada[i], "llamada_%d", i);
+	if (fichero==NULL){
+		fichero = "minikernel/include/llamsis.h";
+		if ((f=fopen(fichero, "r"))==NULL)
+			fichero = "../minikernel/include/llamsis.h";
+		else
+			fclose(f);
+	}
+	if ((f=fopen(fichero, "r"))==NULL){
+		fprintf(stderr, "traza_chrome: no se puede leer %s\n", fichero);
+		return;
+	}
+	while (fgets(linea, sizeof(linea), f))
+		if (sscanf(linea, "#define %31s %d", nombre, &num)==2 &&
+				strcmp(nombre, "NSERVICIOS")!=0 &&
+				num>=0 && num<MAX_LLAMADAS){
+			for (i=0; nombre[i]; i++)
+				nombre[i]=tolower((unsigned char)nombre[i]);
+			strcpy(nombres_llamada[num], nombre);
+		}
+	fclose(f);
+}
+
+/*
+ * Escribe el separador y el comienzo comun de un evento
+ */
+static void empezar_evento(char *fase, char *nombre, int pid, int tid,
+		unsigned long ts){
+	printf("%s\n{\"ph\":\"%s\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,"
+		"\"ts\":%lu", primer_evento ? "" : ",", fase, nombre, pid, tid,
+		ts);
+	primer_evento = 0;
+}
+
+/*
+ * Pid de Chrome de un proceso del minikernel; el 0 es el nucleo
+ */
+static int pid_chrome(int id){
+	return id + 1;
+}
+
+/*
+ * Da de alta un proceso la primera vez que aparece, nombrando sus pistas
+ */
+static proceso * buscar_proceso(int id){
+	proceso *p;
+	int pid;
+
+	if (id<0 || id>=MAX_PROCS)
+		return NULL;
+	p = &procs[id];
+	if (!p->conocido){
+		p->conocido = 1;
+		pid = pid_chrome(id);
+		empezar_evento("M", "process_name", pid, 0, 0);
+		printf(",\"args\":{\"name\":\"proc %d\"}}", id);
+		empezar_evento("M", "thread_name", pid, PISTA_ESTADO, 0);
+		printf(",\"args\":{\"name\":\"estado\"}}");
+		empezar_evento("M", "thread_name", pid, PISTA_LLAMADAS, 0);
+		printf(",\"args\":{\"name\":\"llamadas\"}}");
+	}
+	return p;
+}
+
+/*
+ * Cierra el tramo del estado actual y abre uno nuevo
+ */
+static void cambiar_estado(int id, int estado, unsigned long ts){
+	proceso *p;
+	int pid;
+
+	if ((p=buscar_proceso(id))==NULL)
+		return;
+	pid = pid_chrome(id);
+	if (p->estado!=NINGUNO && ts>=p->desde){
+		empezar_evento("X", nombres_estado[p->estado], pid,
+			PISTA_ESTADO, p->desde);
+		printf(",\"dur\":%lu}", ts - p->desde);
+	}
+	p->estado = estado;
+	p->desde = ts;
+}
+
+static void abrir_llamada(int id, int num, unsigned long ts){
+	proceso *p;
+	int pid;
+
+	if ((p=buscar_proceso(id))==NULL || num<0 || num>=MAX_LLAMADAS)
+		return;
+	pid = pid_chrome(id);
+	empezar_evento("B", nombres_llamada[num], pid, PISTA_LLAMADAS, ts);
+	printf("}");
+	p->en_llamada = 1;
+}
+
+static void cerrar_llamada(int id, int res, unsigned long ts){
+	proceso *p;
+	int pid;
+
+	if ((p=buscar_proceso(id))==NULL || !p->en_llamada)
+		return;
+	pid = pid_chrome(id);
+	empezar_evento("E", "", pid, PISTA_LLAMADAS, ts);
+	printf(",\"args\":{\"resultado\":%d}}", res);
+	p->en_llamada = 0;
+}
+
+static void instantaneo(char *nombre, int pid, int tid, unsigned long ts,
+		int arg){
+	empezar_evento("i", nombre, pid, tid, ts);
+	printf(",\"s\":\"t\",\"args\":{\"arg\":%d}}", arg);
+}
+
+/*
+ * Trata un evento del volcado
+ */
+static void tratar_evento(unsigned long ts, char *ev, int id, int a1,
+		int a2){
+	int pid;
+
+	ultimo_tiempo = ts;
+	if (strcmp(ev, "crear")==0)
+		cambiar_estado(id, LISTO, ts);
+	else if (strcmp(ev, "despertar")==0)
+		cambiar_estado(id, LISTO, ts);
+	else if (strcmp(ev, "bloqueo")==0)
+		cambiar_estado(id, BLOQUEADO, ts);
+	else if (strcmp(ev, "terminar")==0){
+		cerrar_llamada(id, 0, ts);
+		cambiar_estado(id, NINGUNO, ts);
+	}
+	else if (strcmp(ev, "cambio_contexto")==0){
+		if (a2==CC_REPLANIFICACION)
+			cambiar_estado(id, LISTO, ts);
+		cambiar_estado(a1, EJECUCION, ts);
+	}
+	else if (strcmp(ev, "llamada")==0)
+		abrir_llamada(id, a1, ts);
+	else if (strcmp(ev, "fin_llamada")==0)
+		cerrar_llamada(id, a2, ts);
+	else if (strcmp(ev, "prioridad")==0){
+		if (buscar_proceso(id)==NULL)
+			return;
+		pid = pid_chrome(id);
+		empezar_evento("C", "prioridad", pid, PISTA_ESTADO, ts);
+		printf(",\"args\":{\"base\":%d,\"efectiva\":%d}}", a1, a2);
+	}
+	else if (strcmp(ev, "excepcion")==0){
+		if (buscar_proceso(id)==NULL)
+			return;
+		pid = pid_chrome(id);
+		instantaneo(ev, pid, PISTA_ESTADO, ts, a1);
+	}
+	else	/* interrupciones y esperas del nucleo */
+		instantaneo(ev, PID_NUCLEO, 0, ts, a1);
+}
+
+int main(int argc, char *argv[]){
+	FILE *f = stdin;
+	char linea[TAM_LINEA], ev[TAM_NOMBRE], *pos;
+	char *llamsis = NULL;
+	unsigned long ts;
+	int id, a1, a2, version, tick, i;
+
+	for (i=1; i<argc; i++){
+		if (strcmp(argv[i], "-s")==0 && i+1<argc)
+			llamsis = argv[++i];
+		else if ((f=fopen(argv[i], "r"))==NULL){
+			fprintf(stderr, "traza_chrome: no se puede abrir %s\n",
+				argv[i]);
+			return 1;
+		}
+	}
+	leer_llamadas(llamsis);
+
+	printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	empezar_evento("M", "process_name", PID_NUCLEO, 0, 0);
+	printf(",\"args\":{\"name\":\"nucleo\"}}");
+
+	/* las lineas de la traza pueden ir detras de salida de usuario */
+	while (fgets(linea, sizeof(linea), f)){
+		if ((pos=strstr(linea, "#H "))!=NULL){
+			if (sscanf(pos, "#H %d %d", &version, &tick)==2 &&
+					version!=VERSION_TRAZA)
+				fprintf(stderr, "traza_chrome: version de traza %d "
+					"desconocida\n", version);
+		}
+		else if ((pos=strstr(linea, "#T "))!=NULL &&
+				sscanf(pos, "#T %lu %31s %d %d %d", &ts, ev, &id,
+					&a1, &a2)==5)
+			tratar_evento(ts, ev, id, a1, a2);
+	}
+
+	/* se cierran los tramos abiertos al final de la traza */
+	for (i=0; i<MAX_PROCS; i++)
+		if (procs[i].conocido){
+			cerrar_llamada(i, 0, ultimo_tiempo);
+			cambiar_estado(i, NINGUNO, ultimo_tiempo);
+		}
+	printf("\n]}\n");
+	return 0;
+}
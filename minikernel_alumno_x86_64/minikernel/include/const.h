@@ -21,7 +21,14 @@
 #define NULL (void *) 0		/* por si acaso no esta ya definida */
 #endif
 
-#define MAX_PROC 10		/* dimension de tabla de procesos */
+/*
+ * Tabla de procesos: entradas con las que arranca, techo por defecto
+ * hasta el que crece (MINIKERNEL_MAX_PROC lo cambia al arrancar) y
+ * mayor techo admitido, ya que los pid de la traza son short
+ */
+#define PROCS_INICIALES 16
+#define MAX_PROC 1024
+#define LIMITE_PROC 32768
 
 #define TAM_PILA 32768
 
@@ -42,6 +49,155 @@
 #define MIN_PRIO 10
 #define MAX_PRIO 50
 
+/*
+ * Niveles de la cola de listos. La prioridad efectiva converge como
+ * maximo a 2*MAX_PRIO, los valores superiores comparten el ultimo nivel
+ */
+#define NUM_NIVELES_LISTOS (2*MAX_PRIO + 1)
+#define BITS_PALABRA (8 * sizeof(unsigned long))
+#define PALABRAS_MAPA_LISTOS \
+	((NUM_NIVELES_LISTOS + BITS_PALABRA - 1) / BITS_PALABRA)
+#define NO_ENCOLADO -1
+
+/*
+ * Politicas de planificacion. Se usa POLITICA_PLANIF salvo que al
+ * arrancar la variable de entorno MINIKERNEL_PLANIF indique otra
+ * por su nombre ("fifo", "rr", "prio", "stride", "cfs", "mlfq")
+ */
+#define PLANIF_FIFO 0
+#define PLANIF_RR 1
+#define PLANIF_PRIO 2
+#define PLANIF_STRIDE 3
+#define PLANIF_CFS 4
+#define PLANIF_MLFQ 5
+#define NUM_POLITICAS 6
+
+#ifndef POLITICA_PLANIF
+#define POLITICA_PLANIF PLANIF_PRIO
+#endif
+
+#define RODAJA 10		/* ticks de rodaja en round-robin y stride */
+#define ZANCADA_BASE 1048576	/* zancada de un proceso de prioridad 1 */
+
+/* vruntime por tick de un proceso de prioridad 1 en CFS */
+#define VRUNTIME_BASE 1048576
+/* ventaja en vruntime que obliga a ceder la UCP: RODAJA ticks a MAX_PRIO */
+#define GRANULARIDAD_CFS (RODAJA * (VRUNTIME_BASE / MAX_PRIO))
+
+/* niveles de MLFQ, la rodaja se duplica en cada nivel */
+#define NIVELES_MLFQ 4
+#define RODAJA_MLFQ(nivel) ((RODAJA / 2) << (nivel))
+/* ticks entre dos subidas generales al nivel 0 */
+#define PERIODO_SUBIDA_MLFQ (2 * TICK)
+
+/*
+ * Colores de los nodos del arbol rojinegro
+ */
+#define ROJO 0
+#define NEGRO 1
+#define FUERA_ARBOL -1
+
+/*
+ * Clases de planificacion: la de tiempo real (EDF) va siempre por
+ * delante de la politica normal
+ */
+#define CLASE_NORMAL 0
+#define CLASE_TR 1
+
+/* densidades de tiempo real en milesimas; maximo admitido en total */
+#define UTIL_ESCALA 1000
+#define UTIL_MAX_TR 950
+
+/*
+ * Rueda jerarquica de temporizadores: NIVELES_RUEDA niveles de
+ * RANURAS_RUEDA ranuras; cada ranura del nivel n abarca
+ * RANURAS_RUEDA^n ticks
+ */
+#define BITS_RUEDA 6
+#define RANURAS_RUEDA (1 << BITS_RUEDA)
+#define MASCARA_RUEDA (RANURAS_RUEDA - 1)
+#define NIVELES_RUEDA 4
+/* mayor distancia en ticks que admite la rueda */
+#define MAX_ESPERA_RUEDA ((1UL << (BITS_RUEDA * NIVELES_RUEDA)) - 1)
+
+/*
+ * Histogramas de latencia desde que un proceso despierta hasta que
+ * ejecuta: la cubeta b cuenta latencias de 2^(b-1) a 2^b - 1 us y la 0
+ * las nulas. LATENCIA_GLOBAL selecciona el de todas las prioridades.
+ */
+#define NUM_CUBETAS_LATENCIA 32
+#define LATENCIA_GLOBAL 0
+
+/*
+ * Consola asincrona: tamano del anillo de salida (potencia de 2) y
+ * bytes que vuelca como mucho cada interrupcion software
+ */
+#define TAM_CONSOLA 4096
+#define DRENAJE_CONSOLA 512
+
+/*
+ * Terminal: anillo de entrada (potencia de 2), modos de lectura y
+ * caracteres de edicion del modo canonico
+ */
+#define TAM_TERMINAL 256
+#define TERMINAL_CANONICO 0	/* lineas completas, con edicion y eco */
+#define TERMINAL_CRUDO 1	/* cada caracter segun llega */
+#define CAR_BORRAR '\b'
+#define CAR_SUPRIMIR 127	/* tambien borra */
+#define CAR_MATAR_LINEA 21	/* control-U */
+
+/* argumentos de cada peticion de un lote de llamadas (NREGS - 1) */
+#define ARGS_LOTE 5
+
+/*
+ * Traza binaria de eventos del nucleo: tamano del anillo (potencia de
+ * 2) e identificadores de evento
+ */
+#define TAM_TRAZA 4096
+#define VERSION_TRAZA 1		/* formato del volcado */
+#define EV_INT_RELOJ 0
+#define EV_INT_TERMINAL 1	/* arg1: caracter */
+#define EV_INT_SW 2
+#define EV_EXCEPCION 3		/* arg1: vector */
+#define EV_LLAMADA 4		/* arg1: servicio */
+#define EV_FIN_LLAMADA 5	/* arg1: servicio, arg2: resultado */
+#define EV_CAMBIO_CONTEXTO 6	/* pid: anterior, arg1: nuevo, arg2: CC_* */
+#define EV_DESPERTAR 7
+#define EV_PRIORIDAD 8		/* arg1: prioridad, arg2: prioridad efectiva */
+#define EV_CREAR 9		/* pid: nuevo, arg1: padre */
+#define EV_ESPERA_INT 10
+#define EV_BLOQUEO 11
+#define EV_TERMINAR 12
+#define NUM_EVENTOS 13
+
+/*
+ * Niveles y subsistemas de los mensajes de diagnostico. Los mensajes de
+ * nivel mayor que NIVEL_LOG o de subsistemas fuera de MASCARA_LOG no se
+ * compilan; se fijan al compilar con -DNIVEL_LOG=... -DMASCARA_LOG=...
+ */
+#define LOG_NADA 0
+#define LOG_AVISO 1		/* sucesos anomalos o que se dan una vez */
+#define LOG_INFO 2		/* llamadas al sistema y cambios de estado */
+#define LOG_DEPURACION 3	/* detalle por tick y listas de procesos */
+
+#define LOG_PLANIF 1
+#define LOG_TEMPOR 2
+#define LOG_LLAMSIS 4
+#define LOG_PROC 8
+#define LOG_TODOS (LOG_PLANIF | LOG_TEMPOR | LOG_LLAMSIS | LOG_PROC)
+
+#ifndef NIVEL_LOG
+#define NIVEL_LOG LOG_DEPURACION
+#endif
+#ifndef MASCARA_LOG
+#define MASCARA_LOG LOG_TODOS
+#endif
+
+/* motivos de cambio de contexto */
+#define CC_FIN 0
+#define CC_BLOQUEO 1
+#define CC_REPLANIFICACION 2
+
 /*
  * posibles id de padre
  */
@@ -30,16 +30,139 @@
  */
 typedef struct BCP_t *BCPptr;
 
+/*
+ *
+ * Definicion de los contadores de uso de UCP y de planificacion de un
+ * proceso. Debe coincidir con la de usuario/include/servicios.h.
+ *
+ */
+typedef struct{
+	unsigned int ticks_usuario;	/* ticks ejecutando en modo usuario */
+	unsigned int ticks_nucleo;	/* ticks ejecutando en modo sistema */
+	unsigned int ticks_espera;	/* ticks listo sin ejecutar */
+	unsigned int cambios_voluntarios; /* veces que se ha bloqueado */
+	unsigned int cambios_involuntarios; /* veces que ha sido expulsado */
+} contadores_uso;
+
+typedef struct{
+	contadores_uso propio;
+	contadores_uso hijos;		/* de sus hijos ya terminados */
+} uso_proceso;
+
+/*
+ *
+ * Definicion de un histograma de latencias en cubetas log2 de us. Debe
+ * coincidir con la de usuario/include/servicios.h.
+ *
+ */
+typedef struct{
+	unsigned int cubetas[NUM_CUBETAS_LATENCIA];
+	unsigned int num;		/* latencias medidas */
+	unsigned int maximo;		/* mayor latencia en us */
+} histograma_latencia;
+
+/*
+ *
+ * Definicion del reloj monotono que devuelve leer_reloj. Debe coincidir
+ * con la de usuario/include/servicios.h.
+ *
+ */
+typedef struct{
+	unsigned long ticks;		/* ticks de reloj desde el arranque */
+	unsigned long us;		/* us desde el arranque segun el anfitrion */
+} reloj_monotono;
+
+/*
+ *
+ * Definicion de la pagina de datos del nucleo, que los procesos leen
+ * directamente sin llamada al sistema. Refleja siempre al proceso en
+ * ejecucion, como si cada uno tuviera la suya en la misma direccion.
+ * Debe coincidir con la de usuario/include/servicios.h.
+ *
+ */
+typedef struct{
+	int pid;
+	int ppid;
+	unsigned int prioridad;		/* prioridad base */
+	unsigned long ticks;		/* ticks de reloj desde el arranque */
+	const unsigned long *series;	/* n. de creacion de cada pid vivo,
+					   unico por proceso, 0 si libre */
+} datos_nucleo;
+
+/*
+ *
+ * Definicion de una peticion de un lote de llamadas al sistema. Debe
+ * coincidir con la de usuario/include/servicios.h.
+ *
+ */
+typedef struct{
+	int servicio;			/* numero de llamada */
+	int resultado;			/* lo rellena el nucleo */
+	long args[ARGS_LOTE];
+} peticion_lote;
+
+/*
+ *
+ * Definicion del tipo que corresponde con un temporizador. Cuando llega
+ * el tick expiracion se llama a funcion(arg) con interrupciones de
+ * reloj inhibidas.
+ *
+ */
+typedef struct temporizador_t *temporizadorptr;
+
+typedef struct temporizador_t {
+	unsigned long expiracion;	/* tick absoluto de vencimiento */
+	void (*funcion)(void *arg);
+	void *arg;
+	temporizadorptr *ranura;	/* cabeza de su ranura o NULL si inactivo */
+	temporizadorptr siguiente;
+	temporizadorptr anterior;
+} temporizador;
+
 typedef struct BCP_t {
         int id;				/* ident. del proceso */
         int id_padre;           /* ident. del proceso padre o ID_HUERFANO o ID_INIT*/
+        struct BCP_t *primer_hijo; /* lista de sus hijos vivos */
+        struct BCP_t *hermano_sig; /* enlaces en la lista de hijos del padre */
+        struct BCP_t *hermano_ant;
         int estado;			/* TERMINADO|LISTO|EJECUCION|BLOQUEADO*/
-        int nticks;         /* ticks que faltan para cambiarlo de estado */
+        temporizador temp_dormir; /* despierta al proceso dormido */
+        temporizador temp_lectura; /* plazo de lectura del terminal */
         contexto_t contexto_regs;	/* copia de regs. de UCP */
         void * pila;			/* dir. inicial de la pila */
         int prioridad;      /*  Prioridad del proceso  */
         int prioridad_efectiva; /* prioridad efectiva del procesprioridad efectiva del procesoo */
+        int nivel_listo;    /* nivel de la cola de listos en el que esta o NO_ENCOLADO */
+        unsigned int epoca; /* ultima epoca de reajuste aplicada a prioridad_efectiva */
+        int ticks_rodaja;   /* ticks que le quedan de rodaja en round-robin y stride */
+        int pos_monticulo;  /* posicion en el monticulo de listos o NO_ENCOLADO */
+        unsigned long pase; /* pase del proceso en la politica stride */
+        unsigned long zancada; /* avance del pase por tick, ZANCADA_BASE/prioridad */
+        unsigned long vruntime; /* tiempo virtual ejecutado en la politica CFS */
+        int color;          /* ROJO|NEGRO en el arbol de listos o FUERA_ARBOL */
+        BCPptr hijo_izq;    /* hijos y padre en el arbol de listos */
+        BCPptr hijo_der;
+        BCPptr padre_arbol;
+        int nivel_mlfq;     /* nivel en la politica MLFQ, 0 es el mas alto */
+        unsigned int epoca_mlfq; /* ultima subida general de MLFQ que ha visto */
+        int agoto_rodaja_mlfq; /* ha agotado una rodaja desde que se bloqueo */
+        int clase;          /* CLASE_NORMAL|CLASE_TR */
+        unsigned int periodo; /* parametros de tiempo real, en ticks */
+        unsigned int presupuesto;
+        unsigned int plazo;
+        int densidad;       /* presupuesto/plazo en milesimas */
+        int presupuesto_restante; /* ticks que le quedan en el periodo actual */
+        unsigned long plazo_abs; /* plazo absoluto del trabajo actual */
+        unsigned long proximo_periodo; /* tick en que empieza el siguiente */
+        int trabajo_pendiente; /* 1 si el trabajo actual no ha acabado */
+        int esperando_periodo; /* 1 si espera en cola_reposicion */
+        int fallos_plazo;   /* trabajos que han acabado despues de su plazo */
+        contadores_uso uso; /* uso de UCP y de planificacion */
+        contadores_uso uso_hijos; /* uso acumulado de sus hijos terminados */
+        unsigned long tick_listo; /* tick en que paso a listo */
+        unsigned long us_despertar; /* instante en us en que desperto o 0 */
 	BCPptr siguiente;		/* puntero a otro BCP */
+	BCPptr anterior;		/* puntero al BCP previo en la lista */
 	void *info_mem;			/* descriptor del mapa de memoria */
 } BCP;
 
@@ -64,21 +187,265 @@ typedef struct{
 BCP * p_proc_actual=NULL;
 
 /*
- * Variable global que representa la tabla de procesos
+ * Variables globales que representan la tabla de procesos: vector de
+ * punteros a BCP indexado por pid que crece hasta max_procs, entradas
+ * que tiene ahora y lista de BCPs libres. Junto a ella, el numero de
+ * creacion de cada pid vivo (0 si libre) y el ultimo asignado; a
+ * diferencia del pid, el numero no se reutiliza
  */
 
-BCP tabla_procs[MAX_PROC];
+BCP **tabla_procs = NULL;
+int capacidad_procs = 0;
+int max_procs = MAX_PROC;
+lista_BCPs lista_libres= {NULL, NULL};
+unsigned long *series_procs = NULL;
+unsigned long procesos_creados = 0;
 
 /*
- * Variable global que representa la cola de procesos listos
+ * Variable global que representa la cola de procesos listos.
+ * Se usa como identificador en insertar_ultimo y eliminar_elem, los
+ * procesos se guardan en la estructura de la politica de planificacion
  */
 lista_BCPs lista_listos= {NULL, NULL};
 
+/*
+ * Variable global con los procesos listos en orden de llegada
+ * (politicas FIFO y round-robin)
+ */
+lista_BCPs cola_fifo= {NULL, NULL};
+
+/*
+ * Definicion del tipo de la cola de listos: una lista FIFO por cada nivel
+ * de prioridad efectiva y un mapa de bits con los niveles no vacios
+ */
+typedef struct{
+	lista_BCPs niveles[NUM_NIVELES_LISTOS];
+	unsigned long mapa[PALABRAS_MAPA_LISTOS];
+	int num_listos;
+} cola_prioridades;
+
+/*
+ * Variable global que contiene los procesos listos por nivel de prioridad
+ */
+cola_prioridades cola_listos;
+
+/*
+ * Variable global con la epoca actual de reajuste de prioridades
+ */
+unsigned int epoca_prioridades = 0;
+
+/*
+ *
+ * Definicion del tipo que corresponde con un monticulo de BCPs. El
+ * primero es el BCP para el que la funcion antes es cierta frente a
+ * todos los demas.
+ *
+ */
+typedef struct{
+	BCP **elems;			/* con sitio para max_procs */
+	int num;
+	int (*antes)(BCP *a, BCP *b);
+} monticulo_BCPs;
+
+/*
+ * Variable global con los procesos listos ordenados por pase
+ * (politica stride) y el pase de referencia de la politica
+ */
+monticulo_BCPs cola_stride;
+unsigned long pase_global = 0;
+
+/*
+ *
+ * Definicion del tipo que corresponde con un arbol rojinegro de BCPs
+ * ordenado por vruntime.
+ *
+ */
+typedef struct{
+	BCP *raiz;
+	BCP *minimo;		/* el de menor vruntime */
+	int num;
+} arbol_BCPs;
+
+/*
+ * Variable global con los procesos listos ordenados por vruntime
+ * (politica CFS) y el menor vruntime alcanzado por la cola
+ */
+arbol_BCPs cola_cfs= {NULL, NULL, 0};
+unsigned long vruntime_minimo = 0;
+
+/*
+ * Variable global con una cola de listos por nivel (politica MLFQ),
+ * el numero de subidas generales y los ticks desde la ultima
+ */
+lista_BCPs colas_mlfq[NIVELES_MLFQ];
+unsigned int epoca_mlfq = 0;
+int ticks_subida_mlfq = 0;
+
+/*
+ *
+ * Definicion del tipo que corresponde con una politica de planificacion.
+ * Cada politica guarda los procesos listos a su manera y la rutina de
+ * planificacion solo accede a ellos mediante estas operaciones.
+ *
+ */
+typedef struct{
+	char *nombre;
+	void (*encolar)(BCP *proc);	/* proc pasa a la cola de listos */
+	void (*desencolar)(BCP *proc);	/* proc sale de la cola de listos */
+	BCP * (*elegir)();		/* proceso a ejecutar o NULL si no hay */
+	int (*tick)();			/* 1 si el actual debe dejar la UCP */
+	int (*expulsa)(BCP *proc);	/* 1 si proc despertado expulsa al actual */
+	void (*repartir)(BCP *padre, BCP *hijo); /* al crear un proceso */
+	void (*cambio_prio)(BCP *proc, int prioridad_anterior);
+	void (*reajustar)();		/* trabajo que no se hace al encolar ni
+					   al elegir, solo al planificar y en
+					   cada tick; NULL si no hay */
+} politica_planif;
+
+/*
+ * Variable global que apunta a la politica de planificacion activa
+ */
+politica_planif *planif = NULL;
+
+/*
+ * Variable global con el proceso que elegiria ahora el planificador, se
+ * mantiene al dia en cada cambio de las colas de listos
+ */
+BCP *mejor_listo = NULL;
+
+/*
+ * Variables globales de la clase de tiempo real: procesos con
+ * presupuesto ordenados por plazo, procesos que esperan al siguiente
+ * periodo ordenados por su comienzo y densidad total admitida
+ */
+monticulo_BCPs cola_edf;
+monticulo_BCPs cola_reposicion;
+int utilizacion_tr = 0;
+
+/*
+ * Variable global con la pagina de datos del proceso en ejecucion. Se
+ * actualiza en cada cambio de contexto, en cada tick y al cambiar la
+ * prioridad base
+ */
+datos_nucleo pagina_datos;
+
+/*
+ * Variables globales con los histogramas de latencia desde que un
+ * proceso despierta hasta que ejecuta, global y por prioridad base
+ */
+histograma_latencia latencia_global;
+histograma_latencia latencia_prio[MAX_PRIO - MIN_PRIO + 1];
+
+/*
+ *
+ * Definicion de un evento de la traza del nucleo
+ *
+ */
+typedef struct{
+	unsigned long tiempo;		/* us desde el arranque */
+	short evento;			/* EV_* */
+	short pid;			/* proceso afectado o -1 */
+	int arg1;
+	int arg2;
+} evento_traza;
+
+/*
+ * Variables globales de la traza: anillo de eventos, eventos anotados
+ * desde el arranque, primero sin volcar y si esta activa
+ */
+evento_traza traza[TAM_TRAZA];
+unsigned long traza_anotados = 0;
+unsigned long traza_volcados = 0;
+int traza_activa = 0;
+unsigned long us_arranque = 0;
+
+/*
+ * Anota un evento si la traza esta activa; desactivada solo cuesta
+ * la comprobacion
+ */
+#define TRAZA(ev, pid, a1, a2) \
+	do { if (traza_activa) anotar_traza((ev), (pid), (a1), (a2)); } while (0)
+
+/*
+ * Mensajes de diagnostico filtrados al compilar por NIVEL_LOG y
+ * MASCARA_LOG; los descartados no generan codigo. Antes se vacia la
+ * consola para que salgan detras de lo que ya escribieron los procesos
+ */
+#define LOG_ACTIVO(nivel, subsistema) \
+	((nivel) <= NIVEL_LOG && ((subsistema) & MASCARA_LOG))
+#define LOG(nivel, subsistema, ...) \
+	do { if (LOG_ACTIVO(nivel, subsistema)) { \
+		vaciar_consola(); printk(__VA_ARGS__); } } while (0)
+
+/*
+ * Variable global con los procesos existentes
+ */
+int num_procesos = 0;
+
+/*
+ * Variable global con los ticks de reloj desde el arranque
+ */
+unsigned long ticks_sistema = 0;
+
+/*
+ * Variables globales que indican si la UCP esta parada en espera_int y
+ * cuantos ticks ha pasado asi, que no se cobran a ningun proceso
+ */
+int en_espera_int = 0;
+unsigned long ticks_ociosos = 0;
+
+
+/*
+ *
+ * Definicion del tipo que corresponde con la rueda jerarquica de
+ * temporizadores. proximo_tick es el siguiente tick por tratar.
+ *
+ */
+typedef struct{
+	temporizador *ranuras[NIVELES_RUEDA][RANURAS_RUEDA];
+	unsigned long proximo_tick;
+} rueda_temporizadores;
+
+/*
+ * Variable global con los temporizadores activos
+ */
+rueda_temporizadores rueda;
 
 /*
  * Variable global que representa la cola de procesos dormidos
  */
 lista_BCPs lista_dormidos= {NULL, NULL};
+
+/*
+ * Variable global con los procesos despertados en el tick actual que
+ * aun no han pasado a listos
+ */
+lista_BCPs lista_despertados= {NULL, NULL};
+
+/*
+ * Variables globales de la consola asincrona: anillo de salida, bytes
+ * escritos y volcados desde el arranque y procesos que esperan hueco
+ */
+char consola[TAM_CONSOLA];
+unsigned long consola_escritos = 0;
+unsigned long consola_volcados = 0;
+lista_BCPs lista_consola= {NULL, NULL};
+
+/*
+ * Variables globales del terminal: anillo de entrada, caracteres
+ * recibidos, disponibles para leer (en modo canonico, hasta el ultimo
+ * fin de linea) y leidos desde el arranque, procesos que esperan
+ * entrada y modo de lectura con el minimo de caracteres y el plazo en
+ * ticks del modo crudo
+ */
+char terminal[TAM_TERMINAL];
+unsigned long terminal_recibidos = 0;
+unsigned long terminal_disponibles = 0;
+unsigned long terminal_leidos = 0;
+lista_BCPs lista_terminal= {NULL, NULL};
+int modo_terminal = TERMINAL_CANONICO;
+unsigned int terminal_min = 1;
+unsigned long terminal_plazo = 0;
 /*
  *
  * Definicin del tipo que corresponde con una entrada en la tabla de
@@ -87,6 +454,10 @@ lista_BCPs lista_dormidos= {NULL, NULL};
  */
 typedef struct{
 	int (*fservicio)();
+	int bloquea;	/* puede bloquear o terminar: no se admite en lotes */
+	int (*sin_bloqueo)(long *args);	/* si existe, dice si con esos
+					   argumentos no bloquearia y se
+					   admite en un lote */
 } servicio;
 
 
@@ -100,17 +471,51 @@ int sis_get_pid();
 int sis_dormir();
 int sis_fijar_prio();
 int sis_get_ppid();
+int sis_fijar_tiempo_real();
+int sis_fallos_plazo();
+int sis_dormir_ms();
+int sis_dormir_hasta();
+int sis_leer_uso();
+int sis_leer_latencias();
+int sis_volcar_traza();
+int sis_leer_reloj();
+int sis_pagina_datos_nucleo();
+int sis_lote();
+int sis_leer_caracter();
+int sis_leer_linea();
+int sis_leer();
+int sis_fijar_modo_terminal();
+
+/*
+ * Prototipos de las comprobaciones de los servicios que solo bloquean
+ * a veces
+ */
+int escribir_sin_bloqueo(long *args);
 
 /*
  * Variable global que contiene las rutinas que realizan cada llamada
  */
 servicio tabla_servicios[NSERVICIOS]={	{sis_crear_proceso},
-					{sis_terminar_proceso},
-					{sis_escribir},
+					{sis_terminar_proceso, 1},
+					{sis_escribir, 1, escribir_sin_bloqueo},
 					{sis_get_pid},
-					{sis_dormir},
+					{sis_dormir, 1},
                     {sis_fijar_prio},
-                    {sis_get_ppid}};
+                    {sis_get_ppid},
+                    {sis_fijar_tiempo_real},
+                    {sis_fallos_plazo},
+                    {sis_dormir_ms, 1},
+                    {sis_dormir_hasta, 1},
+                    {sis_leer_uso},
+                    {sis_leer_latencias},
+                    {sis_volcar_traza},
+                    {sis_leer_reloj},
+                    {sis_pagina_datos_nucleo},
+                    {sis_lote, 1},
+                    {sis_leer_caracter, 1},
+                    {sis_leer_linea, 1},
+                    {sis_leer, 1},
+                    {sis_fijar_modo_terminal}};
 
 /*
  * Variable glogal que indica si hay una replanificacion pendiente
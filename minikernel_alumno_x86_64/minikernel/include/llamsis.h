@@ -19,7 +19,7 @@
 #define _LLAMSIS_H
 
 /* Numero de llamadas disponibles */
-#define NSERVICIOS 7
+#define NSERVICIOS 21
 
 #define CREAR_PROCESO 0
 #define TERMINAR_PROCESO 1
@@ -28,6 +28,20 @@
 #define DORMIR 4
 #define FIJAR_PRIO 5
 #define GET_PPID 6
+#define FIJAR_TIEMPO_REAL 7
+#define FALLOS_PLAZO 8
+#define DORMIR_MS 9
+#define DORMIR_HASTA 10
+#define LEER_USO 11
+#define LEER_LATENCIAS 12
+#define VOLCAR_TRAZA 13
+#define LEER_RELOJ 14
+#define PAGINA_DATOS_NUCLEO 15
+#define LOTE 16
+#define LEER_CARACTER 17
+#define LEER_LINEA 18
+#define LEER 19
+#define FIJAR_MODO_TERMINAL 20
 
 #endif /* _LLAMSIS_H */
 
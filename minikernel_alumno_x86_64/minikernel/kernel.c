@@ -13,84 +13,1463 @@
  *
  */
 
+#include <stdlib.h>	/* getenv */
+#include <string.h>	/* strcmp memset */
+#include <time.h>	/* clock_gettime */
 #include "kernel.h"	/* Contiene defs. usadas por este modulo */
 
+static void vaciar_consola();	/* la usa LOG */
+
+/*
+ *
+ * Funciones relacionadas con la tabla de procesos:
+ *	crecer_tabla_proc iniciar_tabla_proc buscar_BCP_libre liberar_BCP
+ *
+ * La tabla es un vector de punteros a BCP, asi que los BCPs no se mueven
+ * al crecer. Empieza con PROCS_INICIALES entradas y dobla su tamano
+ * cuando no quedan libres, hasta max_procs, que se toma al arrancar de
+ * la variable de entorno MINIKERNEL_MAX_PROC. Las entradas libres estan
+ * en lista_libres, de modo que reservar y liberar no recorren la tabla.
+ *
+ */
+
+static void insertar_ultimo(lista_BCPs *lista, BCP * proc);
+static void eliminar_primero(lista_BCPs *lista);
+
+/*
+ * Funcion que amplia la tabla de procesos con un bloque de BCPs libres.
+ * Devuelve 0 si ya esta en el techo o no hay memoria.
+ */
+static int crecer_tabla_proc(){
+	BCP **tabla, *bloque;
+	unsigned long *series;
+	int capacidad, i;
+
+	if (capacidad_procs >= max_procs)
+		return 0;
+	capacidad = capacidad_procs ? 2 * capacidad_procs : PROCS_INICIALES;
+	if (capacidad > max_procs)
+		capacidad = max_procs;
+
+	tabla = realloc(tabla_procs, capacidad * sizeof(BCP *));
+	if (tabla == NULL)
+		return 0;
+	tabla_procs = tabla;
+	series = realloc(series_procs, capacidad * sizeof(unsigned long));
+	if (series == NULL)
+		return 0;
+	series_procs = series;
+	pagina_datos.series = series_procs;
+	bloque = calloc(capacidad - capacidad_procs, sizeof(BCP));
+	if (bloque == NULL)
+		return 0;
+
+	for (i=capacidad_procs; i<capacidad; i++){
+		tabla_procs[i]=&bloque[i - capacidad_procs];
+		tabla_procs[i]->id=i;
+		tabla_procs[i]->estado=NO_USADA;
+		tabla_procs[i]->nivel_listo=NO_ENCOLADO;
+		tabla_procs[i]->pos_monticulo=NO_ENCOLADO;
+		tabla_procs[i]->color=FUERA_ARBOL;
+		tabla_procs[i]->clase=CLASE_NORMAL;
+		series_procs[i]=0;
+		insertar_ultimo(&lista_libres, tabla_procs[i]);
+	}
+	capacidad_procs = capacidad;
+	LOG(LOG_INFO, LOG_PROC, "-> TABLA DE PROCESOS: %d ENTRADAS\n", capacidad);
+	return 1;
+}
+
+/*
+ * Funcin que inicia la tabla de procesos
+ */
+static void iniciar_tabla_proc(){
+	char *techo;
+
+	techo=getenv("MINIKERNEL_MAX_PROC");
+	if (techo)
+		max_procs=atoi(techo);
+	if (max_procs < 1 || max_procs > LIMITE_PROC){
+		LOG(LOG_AVISO, LOG_PROC, "-> MINIKERNEL_MAX_PROC NO VALIDO, SE USA %d\n", MAX_PROC);
+		max_procs=MAX_PROC;
+	}
+	if (!crecer_tabla_proc())
+		panico("no hay memoria para la tabla de procesos");
+}
+
+/*
+ * Funcin que busca una entrada libre en la tabla de procesos
+ */
+static int buscar_BCP_libre(){
+	BCP *proc;
+
+	if (lista_libres.primero==NULL && !crecer_tabla_proc())
+		return -1;
+	proc=lista_libres.primero;
+	eliminar_primero(&lista_libres);
+	return proc->id;
+}
+
+/*
+ * Funcion que devuelve una entrada de la tabla de procesos a las libres
+ */
+static void liberar_BCP(BCP *proc){
+	proc->estado=NO_USADA;
+	series_procs[proc->id]=0;
+	insertar_ultimo(&lista_libres, proc);
+}
+
+/*
+ *
+ * Funciones que facilitan el manejo de las listas de BCPs
+ *	insertar_ultimo eliminar_primero eliminar_elem concatenar_listas
+ *
+ * NOTA: PRIMERO SE DEBE LLAMAR A eliminar Y LUEGO A insertar
+ *
+ * Si la lista es lista_listos la operacion se redirige a la politica
+ * de planificacion activa (encolar desencolar) o a la clase de tiempo
+ * real si el proceso pertenece a ella
+ */
+static void tr_encolar(BCP * proc);
+static void tr_desencolar(BCP * proc);
+static void actualizar_mejor_listo();
+
+/*
+ * Inserta un BCP al final de la lista.
+ */
+static void insertar_ultimo(lista_BCPs *lista, BCP * proc){
+	if (lista==&lista_listos){
+		if (proc->clase==CLASE_TR)
+			tr_encolar(proc);
+		else
+			planif->encolar(proc);
+		actualizar_mejor_listo();
+		return;
+	}
+	if (lista->primero==NULL)
+		lista->primero= proc;
+	else
+		lista->ultimo->siguiente=proc;
+	proc->anterior=lista->ultimo;
+	lista->ultimo= proc;
+	proc->siguiente=NULL;
+}
+
+/*
+ * Elimina el primer BCP de la lista.
+ */
+static void eliminar_primero(lista_BCPs *lista){
+
+	if (lista->ultimo==lista->primero)
+		lista->ultimo=NULL;
+	lista->primero=lista->primero->siguiente;
+	if (lista->primero)
+		lista->primero->anterior=NULL;
+}
+
+/*
+ * Elimina un determinado BCP de la lista. Como la lista es doblemente
+ * enlazada no hace falta recorrerla.
+ */
+static void eliminar_elem(lista_BCPs *lista, BCP * proc){
+	if (lista==&lista_listos){
+		if (proc->clase==CLASE_TR)
+			tr_desencolar(proc);
+		else
+			planif->desencolar(proc);
+		actualizar_mejor_listo();
+		return;
+	}
+	if (lista->primero==proc)
+		eliminar_primero(lista);
+	else if (proc->anterior) {
+		if (lista->ultimo==proc)
+			lista->ultimo=proc->anterior;
+		else
+			proc->siguiente->anterior=proc->anterior;
+		proc->anterior->siguiente=proc->siguiente;
+	}
+	else
+		return;	/* el proceso no esta en la lista */
+	proc->siguiente=NULL;
+	proc->anterior=NULL;
+}
+
+/*
+ * Pasa todos los BCPs de la lista origen al final de la lista destino
+ */
+static void concatenar_listas(lista_BCPs *destino, lista_BCPs *origen){
+	if (origen->primero==NULL)
+		return;
+	if (destino->primero==NULL)
+		destino->primero=origen->primero;
+	else {
+		destino->ultimo->siguiente=origen->primero;
+		origen->primero->anterior=destino->ultimo;
+	}
+	destino->ultimo=origen->ultimo;
+	origen->primero=NULL;
+	origen->ultimo=NULL;
+}
+
+/*
+ *
+ * Funciones que facilitan el manejo de los monticulos de BCPs
+ *	iniciar_monticulo insertar_monticulo eliminar_monticulo
+ *	actualizar_monticulo primero_monticulo
+ *
+ * El monticulo es un array ordenado por la funcion antes del propio
+ * monticulo, con el primero en la posicion 0. Cada BCP guarda su
+ * posicion para poder eliminarlo o recolocarlo sin buscarlo.
+ *
+ */
+
+/*
+ * Reserva el array del monticulo con sitio para todos los procesos que
+ * puede llegar a haber
+ */
+static void iniciar_monticulo(monticulo_BCPs *m, int (*antes)(BCP *a, BCP *b)){
+	m->elems=malloc(max_procs * sizeof(BCP *));
+	if (m->elems==NULL)
+		panico("no hay memoria para los monticulos de planificacion");
+	m->num=0;
+	m->antes=antes;
+}
+
+/*
+ * Intercambia dos posiciones del monticulo
+ */
+static void intercambiar_monticulo(monticulo_BCPs *m, int i, int j){
+	BCP *paux=m->elems[i];
+
+	m->elems[i]=m->elems[j];
+	m->elems[j]=paux;
+	m->elems[i]->pos_monticulo=i;
+	m->elems[j]->pos_monticulo=j;
+}
+
+/*
+ * Sube un elemento mientras deba salir antes que su padre
+ */
+static void subir_monticulo(monticulo_BCPs *m, int i){
+	while ((i>0) && m->antes(m->elems[i], m->elems[(i-1)/2])){
+		intercambiar_monticulo(m, i, (i-1)/2);
+		i=(i-1)/2;
+	}
+}
+
+/*
+ * Baja un elemento mientras alguno de sus hijos deba salir antes
+ */
+static void bajar_monticulo(monticulo_BCPs *m, int i){
+	int hijo;
+
+	while ((hijo=2*i+1) < m->num){
+		if ((hijo+1 < m->num) && m->antes(m->elems[hijo+1], m->elems[hijo]))
+			hijo++;
+		if (!m->antes(m->elems[hijo], m->elems[i]))
+			break;
+		intercambiar_monticulo(m, i, hijo);
+		i=hijo;
+	}
+}
+
+/*
+ * Inserta un BCP en el monticulo
+ */
+static void insertar_monticulo(monticulo_BCPs *m, BCP * proc){
+	m->elems[m->num]=proc;
+	proc->pos_monticulo=m->num++;
+	subir_monticulo(m, proc->pos_monticulo);
+}
+
+/*
+ * Elimina un determinado BCP del monticulo
+ */
+static void eliminar_monticulo(monticulo_BCPs *m, BCP * proc){
+	int i=proc->pos_monticulo;
+
+	if (i==NO_ENCOLADO)
+		return;
+	proc->pos_monticulo=NO_ENCOLADO;
+	if (i==--m->num)
+		return;
+	/* el ultimo ocupa su hueco y se recoloca */
+	m->elems[i]=m->elems[m->num];
+	m->elems[i]->pos_monticulo=i;
+	subir_monticulo(m, i);
+	bajar_monticulo(m, m->elems[i]->pos_monticulo);
+}
+
+/*
+ * Recoloca un BCP del monticulo despues de cambiar su clave
+ */
+static void actualizar_monticulo(monticulo_BCPs *m, BCP * proc){
+	if (proc->pos_monticulo==NO_ENCOLADO)
+		return;
+	subir_monticulo(m, proc->pos_monticulo);
+	bajar_monticulo(m, proc->pos_monticulo);
+}
+
+/*
+ * Retorna el primer BCP del monticulo o NULL si esta vacio
+ */
+static BCP * primero_monticulo(monticulo_BCPs *m){
+	return m->num ? m->elems[0] : NULL;
+}
+
+/*
+ *
+ * Funciones que facilitan el manejo de los arboles rojinegros de BCPs
+ *	insertar_arbol eliminar_arbol
+ *
+ * El arbol esta ordenado por vruntime; los BCPs con el mismo valor
+ * quedan en orden de llegada. Se guarda aparte el de menor vruntime
+ * para poder consultarlo sin recorrer el arbol. Un BCP que no esta en
+ * ningun arbol tiene color FUERA_ARBOL.
+ *
+ */
+
+/*
+ * Sustituye en el arbol el subarbol con raiz u por el de raiz v
+ */
+static void trasplantar_arbol(arbol_BCPs *a, BCP *u, BCP *v){
+	if (u->padre_arbol==NULL)
+		a->raiz=v;
+	else if (u==u->padre_arbol->hijo_izq)
+		u->padre_arbol->hijo_izq=v;
+	else
+		u->padre_arbol->hijo_der=v;
+	if (v)
+		v->padre_arbol=u->padre_arbol;
+}
+
+static void rotar_izq(arbol_BCPs *a, BCP *x){
+	BCP *y=x->hijo_der;
+
+	x->hijo_der=y->hijo_izq;
+	if (y->hijo_izq)
+		y->hijo_izq->padre_arbol=x;
+	trasplantar_arbol(a, x, y);
+	y->hijo_izq=x;
+	x->padre_arbol=y;
+}
+
+static void rotar_der(arbol_BCPs *a, BCP *x){
+	BCP *y=x->hijo_izq;
+
+	x->hijo_izq=y->hijo_der;
+	if (y->hijo_der)
+		y->hijo_der->padre_arbol=x;
+	trasplantar_arbol(a, x, y);
+	y->hijo_der=x;
+	x->padre_arbol=y;
+}
+
+/*
+ * Retorna el BCP de menor vruntime del subarbol
+ */
+static BCP * minimo_subarbol(BCP *paux){
+	while (paux->hijo_izq)
+		paux=paux->hijo_izq;
+	return paux;
+}
+
+/*
+ * Inserta un BCP en el arbol y restaura las propiedades rojinegras
+ */
+static void insertar_arbol(arbol_BCPs *a, BCP * proc){
+	BCP *padre=NULL, *paux=a->raiz, *abuelo, *tio;
+	int es_minimo=1;
+
+	while (paux){
+		padre=paux;
+		if (proc->vruntime < paux->vruntime)
+			paux=paux->hijo_izq;
+		else {
+			paux=paux->hijo_der;
+			es_minimo=0;
+		}
+	}
+	proc->padre_arbol=padre;
+	proc->hijo_izq=NULL;
+	proc->hijo_der=NULL;
+	proc->color=ROJO;
+	if (padre==NULL)
+		a->raiz=proc;
+	else if (proc->vruntime < padre->vruntime)
+		padre->hijo_izq=proc;
+	else
+		padre->hijo_der=proc;
+	if (es_minimo)
+		a->minimo=proc;
+	a->num++;
+
+	/* mientras haya dos rojos seguidos se recolorea o se rota */
+	while ((padre=proc->padre_arbol) && (padre->color==ROJO)){
+		abuelo=padre->padre_arbol;
+		if (padre==abuelo->hijo_izq){
+			tio=abuelo->hijo_der;
+			if (tio && (tio->color==ROJO)){
+				padre->color=NEGRO;
+				tio->color=NEGRO;
+				abuelo->color=ROJO;
+				proc=abuelo;
+				continue;
+			}
+			if (proc==padre->hijo_der){
+				rotar_izq(a, padre);
+				proc=padre;
+				padre=proc->padre_arbol;
+			}
+			padre->color=NEGRO;
+			abuelo->color=ROJO;
+			rotar_der(a, abuelo);
+		}
+		else {
+			tio=abuelo->hijo_izq;
+			if (tio && (tio->color==ROJO)){
+				padre->color=NEGRO;
+				tio->color=NEGRO;
+				abuelo->color=ROJO;
+				proc=abuelo;
+				continue;
+			}
+			if (proc==padre->hijo_izq){
+				rotar_der(a, padre);
+				proc=padre;
+				padre=proc->padre_arbol;
+			}
+			padre->color=NEGRO;
+			abuelo->color=ROJO;
+			rotar_izq(a, abuelo);
+		}
+	}
+	a->raiz->color=NEGRO;
+}
+
+/*
+ * Restaura las propiedades rojinegras tras eliminar un nodo negro.
+ * x puede ser NULL, por eso se recibe tambien su padre.
+ */
+static void arreglar_borrado_arbol(arbol_BCPs *a, BCP *x, BCP *padre){
+	BCP *w;
+
+	while ((x!=a->raiz) && ((x==NULL) || (x->color==NEGRO))){
+		if (x==padre->hijo_izq){
+			w=padre->hijo_der;
+			if (w->color==ROJO){
+				w->color=NEGRO;
+				padre->color=ROJO;
+				rotar_izq(a, padre);
+				w=padre->hijo_der;
+			}
+			if (((w->hijo_izq==NULL) || (w->hijo_izq->color==NEGRO)) &&
+			    ((w->hijo_der==NULL) || (w->hijo_der->color==NEGRO))){
+				w->color=ROJO;
+				x=padre;
+				padre=x->padre_arbol;
+				continue;
+			}
+			if ((w->hijo_der==NULL) || (w->hijo_der->color==NEGRO)){
+				w->hijo_izq->color=NEGRO;
+				w->color=ROJO;
+				rotar_der(a, w);
+				w=padre->hijo_der;
+			}
+			w->color=padre->color;
+			padre->color=NEGRO;
+			if (w->hijo_der)
+				w->hijo_der->color=NEGRO;
+			rotar_izq(a, padre);
+		}
+		else {
+			w=padre->hijo_izq;
+			if (w->color==ROJO){
+				w->color=NEGRO;
+				padre->color=ROJO;
+				rotar_der(a, padre);
+				w=padre->hijo_izq;
+			}
+			if (((w->hijo_izq==NULL) || (w->hijo_izq->color==NEGRO)) &&
+			    ((w->hijo_der==NULL) || (w->hijo_der->color==NEGRO))){
+				w->color=ROJO;
+				x=padre;
+				padre=x->padre_arbol;
+				continue;
+			}
+			if ((w->hijo_izq==NULL) || (w->hijo_izq->color==NEGRO)){
+				w->hijo_der->color=NEGRO;
+				w->color=ROJO;
+				rotar_izq(a, w);
+				w=padre->hijo_izq;
+			}
+			w->color=padre->color;
+			padre->color=NEGRO;
+			if (w->hijo_izq)
+				w->hijo_izq->color=NEGRO;
+			rotar_der(a, padre);
+		}
+		x=a->raiz;
+	}
+	if (x)
+		x->color=NEGRO;
+}
+
+/*
+ * Elimina un determinado BCP del arbol
+ */
+static void eliminar_arbol(arbol_BCPs *a, BCP * proc){
+	BCP *y, *x, *padre_x;
+	int color_eliminado;
+
+	if (proc->color==FUERA_ARBOL)
+		return;
+
+	/* el minimo no tiene hijo izquierdo, le sigue su hijo derecho o su padre */
+	if (a->minimo==proc)
+		a->minimo=proc->hijo_der ? minimo_subarbol(proc->hijo_der) :
+			proc->padre_arbol;
+
+	color_eliminado=proc->color;
+	if (proc->hijo_izq==NULL){
+		x=proc->hijo_der;
+		padre_x=proc->padre_arbol;
+		trasplantar_arbol(a, proc, proc->hijo_der);
+	}
+	else if (proc->hijo_der==NULL){
+		x=proc->hijo_izq;
+		padre_x=proc->padre_arbol;
+		trasplantar_arbol(a, proc, proc->hijo_izq);
+	}
+	else {
+		/* su sucesor ocupa su lugar */
+		y=minimo_subarbol(proc->hijo_der);
+		color_eliminado=y->color;
+		x=y->hijo_der;
+		if (y->padre_arbol==proc)
+			padre_x=y;
+		else {
+			padre_x=y->padre_arbol;
+			trasplantar_arbol(a, y, y->hijo_der);
+			y->hijo_der=proc->hijo_der;
+			y->hijo_der->padre_arbol=y;
+		}
+		trasplantar_arbol(a, proc, y);
+		y->hijo_izq=proc->hijo_izq;
+		y->hijo_izq->padre_arbol=y;
+		y->color=proc->color;
+	}
+	if (color_eliminado==NEGRO)
+		arreglar_borrado_arbol(a, x, padre_x);
+
+	proc->color=FUERA_ARBOL;
+	a->num--;
+}
+
+/*
+ *
+ * Funciones del subsistema de temporizadores
+ *	iniciar_temporizador armar_temporizador cancelar_temporizador
+ *	avanzar_rueda
+ *
+ * Los temporizadores activos estan en una rueda jerarquica segun la
+ * distancia a su vencimiento: en el nivel 0 hay una ranura por tick y
+ * cada ranura de un nivel superior abarca una vuelta completa del
+ * inferior. Insertar y cancelar es O(1); cuando el nivel 0 da la vuelta
+ * se reparte la siguiente ranura del nivel superior (cascada) y en cada
+ * tick solo se tratan los temporizadores que vencen.
+ *
+ */
+
+/*
+ * Coloca un temporizador en la ranura que le corresponde segun lo que
+ * falta para su vencimiento. Si falta mas de lo que abarca la rueda va
+ * a la ranura mas lejana sin cambiar su vencimiento; cuando esa ranura
+ * baje en cascada se vuelve a colocar segun lo que falte entonces.
+ */
+static void insertar_rueda(temporizador *t){
+	unsigned long distancia, destino;
+	temporizador **ranura;
+	int n;
+
+	/* si ya ha vencido se trata en el proximo tick */
+	destino = t->expiracion;
+	if (destino < rueda.proximo_tick)
+		destino = rueda.proximo_tick;
+	distancia = destino - rueda.proximo_tick;
+	if (distancia > MAX_ESPERA_RUEDA){
+		distancia = MAX_ESPERA_RUEDA;
+		destino = rueda.proximo_tick + distancia;
+	}
+	for (n=0; n<NIVELES_RUEDA-1; n++)
+		if (distancia < (1UL << (BITS_RUEDA*(n+1))))
+			break;
+	ranura = &rueda.ranuras[n][(destino >> (BITS_RUEDA*n)) &
+		MASCARA_RUEDA];
+
+	t->ranura = ranura;
+	t->anterior = NULL;
+	t->siguiente = *ranura;
+	if (*ranura)
+		(*ranura)->anterior = t;
+	*ranura = t;
+}
+
+/*
+ * Saca un temporizador de su ranura
+ */
+static void quitar_rueda(temporizador *t){
+	if (t->anterior)
+		t->anterior->siguiente = t->siguiente;
+	else
+		*t->ranura = t->siguiente;
+	if (t->siguiente)
+		t->siguiente->anterior = t->anterior;
+	t->ranura = NULL;
+	t->siguiente = NULL;
+	t->anterior = NULL;
+}
+
+/*
+ * Prepara un temporizador inactivo que llamara a funcion(arg)
+ */
+static void iniciar_temporizador(temporizador *t, void (*funcion)(void *),
+		void *arg){
+	t->funcion = funcion;
+	t->arg = arg;
+	t->ranura = NULL;
+	t->siguiente = NULL;
+	t->anterior = NULL;
+}
+
+/*
+ * Activa el temporizador para el tick absoluto expiracion. Si ya estaba
+ * activo se cambia su vencimiento.
+ */
+static void armar_temporizador(temporizador *t, unsigned long expiracion){
+	int nivel;
+
+	nivel=fijar_nivel_int(NIVEL_3);
+	if (t->ranura)
+		quitar_rueda(t);
+	t->expiracion = expiracion;
+	insertar_rueda(t);
+	fijar_nivel_int(nivel);
+}
+
+/*
+ * Desactiva el temporizador si estaba activo
+ */
+static void cancelar_temporizador(temporizador *t){
+	int nivel;
+
+	nivel=fijar_nivel_int(NIVEL_3);
+	if (t->ranura)
+		quitar_rueda(t);
+	fijar_nivel_int(nivel);
+}
+
+/*
+ * Reparte los temporizadores de una ranura de un nivel superior en los
+ * niveles inferiores
+ */
+static void cascada_rueda(int n, int i){
+	temporizador *t;
+
+	while ((t=rueda.ranuras[n][i])){
+		quitar_rueda(t);
+		insertar_rueda(t);
+	}
+}
+
+/*
+ * Trata los ticks pendientes hasta ahora, llamando a la funcion de los
+ * temporizadores que vencen. Se invoca con interrupciones inhibidas.
+ */
+static void avanzar_rueda(unsigned long ahora){
+	temporizador *t;
+	int i, n;
+
+	while (rueda.proximo_tick <= ahora){
+		i = rueda.proximo_tick & MASCARA_RUEDA;
+		/* al dar la vuelta el nivel 0 se baja la ranura del siguiente */
+		if (i == 0)
+			for (n=1; n<NIVELES_RUEDA; n++){
+				i = (rueda.proximo_tick >> (BITS_RUEDA*n)) &
+					MASCARA_RUEDA;
+				cascada_rueda(n, i);
+				if (i != 0)
+					break;
+			}
+		i = rueda.proximo_tick & MASCARA_RUEDA;
+		rueda.proximo_tick++;
+		while ((t=rueda.ranuras[0][i])){
+			quitar_rueda(t);
+			t->funcion(t->arg);
+		}
+	}
+}
+
+/*
+ *
+ * Funciones de la traza del nucleo
+ *	reloj_us iniciar_traza anotar_traza volcar_traza
+ *
+ * Los eventos se guardan en binario en un anillo de TAM_TRAZA entradas
+ * que sobrescribe los mas antiguos. Se activa arrancando con la variable
+ * de entorno MINIKERNEL_TRAZA y se vuelca con volcar_traza o al terminar
+ * el ultimo proceso, con una cabecera y una linea por evento:
+ *	#H <VERSION_TRAZA> <TICK>
+ *	#T <us> <evento> <pid> <arg1> <arg2>
+ * herramientas/traza_chrome convierte el volcado al formato de Chrome.
+ *
+ */
+
+/*
+ * Funcion que devuelve el instante actual en microsegundos segun el
+ * reloj monotono del anfitrion, mas fino que el tick y que no salta
+ * si se cambia la hora
+ */
+static unsigned long reloj_us(){
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (unsigned long)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+/*
+ * Nombres de los eventos en el volcado, indexados por EV_*
+ */
+static char *nombres_evento[NUM_EVENTOS]={
+	"int_reloj", "int_terminal", "int_sw", "excepcion", "llamada",
+	"fin_llamada", "cambio_contexto", "despertar", "prioridad", "crear",
+	"espera_int", "bloqueo", "terminar"};
+
+static void iniciar_traza(){
+	us_arranque = reloj_us();
+	traza_activa = (getenv("MINIKERNEL_TRAZA") != NULL);
+	if (traza_activa)
+		LOG(LOG_AVISO, LOG_PLANIF, "-> TRAZA ACTIVA\n");
+}
+
+/*
+ * Anota un evento en el anillo; se usa a traves de la macro TRAZA
+ */
+static void anotar_traza(int evento, int pid, int arg1, int arg2){
+	evento_traza *e;
+	int nivel;
+
+	nivel=fijar_nivel_int(NIVEL_3);
+	e = &traza[traza_anotados & (TAM_TRAZA - 1)];
+	traza_anotados++;
+	e->tiempo = reloj_us() - us_arranque;
+	e->evento = evento;
+	e->pid = pid;
+	e->arg1 = arg1;
+	e->arg2 = arg2;
+	fijar_nivel_int(nivel);
+}
+
+/*
+ * Vuelca los eventos anotados desde el ultimo volcado que siguen en el
+ * anillo
+ */
+static void volcar_traza(){
+	evento_traza *e;
+	unsigned long i;
+	int nivel;
+
+	nivel=fijar_nivel_int(NIVEL_3);
+	vaciar_consola();
+	if (traza_anotados - traza_volcados > TAM_TRAZA){
+		printk("== TRAZA: %lu EVENTOS PERDIDOS\n",
+			traza_anotados - traza_volcados - TAM_TRAZA);
+		traza_volcados = traza_anotados - TAM_TRAZA;
+	}
+	printk("== TRAZA: %lu EVENTOS\n", traza_anotados - traza_volcados);
+	printk("#H %d %d\n", VERSION_TRAZA, TICK);
+	for (i = traza_volcados; i < traza_anotados; i++){
+		e = &traza[i & (TAM_TRAZA - 1)];
+		printk("#T %lu %s %d %d %d\n", e->tiempo,
+			nombres_evento[e->evento], e->pid, e->arg1, e->arg2);
+	}
+	printk("== FIN TRAZA\n");
+	traza_volcados = traza_anotados;
+	fijar_nivel_int(nivel);
+}
+
+/*
+ *
+ * Politicas de planificacion. Cada una implementa las operaciones de
+ * politica_planif y guarda los procesos listos en su propia estructura.
+ * El proceso en ejecucion permanece en la cola de listos.
+ *	FIFO: fifo_encolar fifo_desencolar fifo_elegir
+ *	round-robin: rr_encolar rr_tick
+ *	prioridades con decaimiento: insertar_listo eliminar_listo
+ *		maxima_prioridad prio_tick prio_expulsa prio_repartir
+ *		prio_cambio_prio prio_reajustar
+ *	stride: stride_encolar stride_desencolar stride_elegir stride_tick
+ *		stride_expulsa stride_repartir stride_cambio_prio
+ *	CFS: cfs_encolar cfs_desencolar cfs_elegir cfs_tick cfs_expulsa
+ *		cfs_repartir
+ *	MLFQ: mlfq_encolar mlfq_desencolar mlfq_elegir mlfq_tick
+ *		mlfq_expulsa mlfq_repartir
+ *
+ */
+
+/*
+ * Politica FIFO. Los listos se guardan en cola_fifo por orden de
+ * llegada y se ejecuta el primero hasta que se bloquea o termina.
+ */
+static void fifo_encolar(BCP * proc){
+	insertar_ultimo(&cola_fifo, proc);
+}
+
+static void fifo_desencolar(BCP * proc){
+	eliminar_elem(&cola_fifo, proc);
+}
+
+static BCP * fifo_elegir(){
+	return cola_fifo.primero;
+}
+
+/* sin expulsion: ni el reloj ni los despertados quitan la UCP */
+static int fifo_tick(){
+	return 0;
+}
+
+static int fifo_expulsa(BCP * proc){
+	return 0;
+}
+
+static void fifo_repartir(BCP * padre, BCP * hijo){
+	return;
+}
+
+static void fifo_cambio_prio(BCP * proc, int prioridad_anterior){
+	return;
+}
+
+/*
+ * Politica round-robin. Usa la cola de FIFO pero el proceso que agota
+ * su rodaja de RODAJA ticks pasa al final de la cola.
+ */
+static void rr_encolar(BCP * proc){
+	proc->ticks_rodaja = RODAJA;
+	insertar_ultimo(&cola_fifo, proc);
+}
+
+static int rr_tick(){
+	if (--p_proc_actual->ticks_rodaja > 0)
+		return 0;
+	LOG(LOG_DEPURACION, LOG_PLANIF, "-> PROCESO %d AGOTA SU RODAJA\n", p_proc_actual->id);
+	fifo_desencolar(p_proc_actual);
+	rr_encolar(p_proc_actual);
+	return p_proc_actual != fifo_elegir();
+}
+
+/*
+ * Politica de prioridades con decaimiento. Hay una lista FIFO por
+ * nivel de prioridad efectiva y un mapa de bits con los niveles que
+ * tienen algun proceso, de modo que insertar, eliminar y buscar el mas
+ * prioritario tienen coste constante.
+ */
+
+/*
+ * Retorna el nivel de la cola que corresponde a una prioridad efectiva
+ */
+static int nivel_prioridad(int prioridad_efectiva){
+	if (prioridad_efectiva < 0)
+		return 0;
+	if (prioridad_efectiva >= NUM_NIVELES_LISTOS)
+		return NUM_NIVELES_LISTOS - 1;
+	return prioridad_efectiva;
+}
+
+/*
+ * Aplica a un proceso los reajustes (prio_e/2 + prio) de las epocas
+ * que se ha perdido. La prioridad efectiva alcanza enseguida un punto
+ * fijo, a partir del cual las epocas restantes ya no la cambian.
+ */
+static void normalizar_prioridad(BCP * proc){
+	int prioridad_e;
+
+	while (proc->epoca != epoca_prioridades){
+		prioridad_e = (proc->prioridad_efectiva / 2) + proc->prioridad;
+		proc->epoca++;
+		if (prioridad_e == proc->prioridad_efectiva)
+			proc->epoca = epoca_prioridades;
+		proc->prioridad_efectiva = prioridad_e;
+	}
+}
+
+/*
+ * Inserta un proceso al final de la lista de su nivel y marca el nivel
+ */
+static void insertar_listo(BCP * proc){
+	int nivel;
+
+	normalizar_prioridad(proc);
+	nivel = nivel_prioridad(proc->prioridad_efectiva);
+	insertar_ultimo(&cola_listos.niveles[nivel], proc);
+	cola_listos.mapa[nivel / BITS_PALABRA] |= 1UL << (nivel % BITS_PALABRA);
+	proc->nivel_listo = nivel;
+	cola_listos.num_listos++;
+}
+
+/*
+ * Elimina un proceso de la lista de su nivel y desmarca el nivel si queda vacio
+ */
+static void eliminar_listo(BCP * proc){
+	int nivel = proc->nivel_listo;
+
+	if (nivel == NO_ENCOLADO)
+		return;
+	eliminar_elem(&cola_listos.niveles[nivel], proc);
+	if (cola_listos.niveles[nivel].primero == NULL)
+		cola_listos.mapa[nivel / BITS_PALABRA] &= ~(1UL << (nivel % BITS_PALABRA));
+	proc->nivel_listo = NO_ENCOLADO;
+	cola_listos.num_listos--;
+}
+
+/*
+ * Retorna el nivel no vacio mas alto o NO_ENCOLADO si no hay listos.
+ * Busca el primer bit activo empezando por la palabra mas alta.
+ */
+static int nivel_maximo(){
+	int i;
+
+	for (i = PALABRAS_MAPA_LISTOS - 1; i >= 0; i--)
+		if (cola_listos.mapa[i])
+			return i * BITS_PALABRA +
+				(BITS_PALABRA - 1 - __builtin_clzl(cola_listos.mapa[i]));
+	return NO_ENCOLADO;
+}
+
+/*
+ * Mueve un proceso listo al nivel de su prioridad efectiva actual.
+ * Se debe llamar cada vez que cambia la prioridad efectiva.
+ */
+static void recolocar_listo(BCP * proc){
+	if (proc->nivel_listo == NO_ENCOLADO)
+		return;
+	if (proc->nivel_listo == nivel_prioridad(proc->prioridad_efectiva))
+		return;
+	eliminar_listo(proc);
+	insertar_listo(proc);
+}
+
+/*
+ * Funcion que empieza una nueva epoca de reajuste de prioridades.
+ * No recorre la tabla de procesos: los bloqueados se normalizan al
+ * volver a la cola de listos y los listos, que en este momento estan
+ * todos en el nivel 0, se reinsertan ya normalizados.
+ */
+static void nueva_epoca(){
+    BCP * paux, * ultimo;
+
+    LOG(LOG_INFO, LOG_PLANIF, "NECESARIO REAJUSTE GLOBAL DE PRIORIDADES\n");
+    epoca_prioridades++;
+
+    /* los que vuelvan a caer en el nivel 0 quedan detras de ultimo */
+    ultimo = cola_listos.niveles[0].ultimo;
+    do{
+        paux = cola_listos.niveles[0].primero;
+        eliminar_listo(paux);
+        insertar_listo(paux);
+    }while(paux != ultimo);
+}
+
+/* 
+ *Funcion que retorna el proceso listo con maxima prioridad. Solo
+ * consulta: se usa en cada cambio de las colas, tambien desde las
+ * interrupciones, y el reajuste se deja a prio_reajustar
+ */
+static BCP * maxima_prioridad(){
+    int nivel;
+
+    /* el primero del nivel mas alto es el proceso con max_prio */
+    nivel = nivel_maximo();
+    if(nivel == NO_ENCOLADO)
+        return NULL;
+    return cola_listos.niveles[nivel].primero;
+}
+
+/*
+ * Si la maxima prioridad de los listos es 0 empieza una nueva epoca.
+ * Solo se llama al planificar y en cada tick.
+ */
+static void prio_reajustar(){
+    if(nivel_maximo() == 0)
+        nueva_epoca();
+}
+
+/*
+ * Decrementa la prioridad efectiva del proceso actual. Cuando llega a 0
+ * debe dejar la UCP si hay otro proceso mejor.
+ */
+static int prio_tick(){
+    //decrementamos la prio_efectiva del proceso actual
+    p_proc_actual->prioridad_efectiva -=1;
+    recolocar_listo(p_proc_actual);
+    // si ha llegado a 0
+    if(p_proc_actual->prioridad_efectiva != 0)
+        return 0;
+    LOG(LOG_DEPURACION, LOG_PLANIF, "-> PROCESO %d AGOTA TIEMPO DE USO DE CPU\n",p_proc_actual->id);
+    return 1;
+}
+
+/*
+ * Un proceso despertado expulsa al actual si tiene mas prioridad efectiva
+ */
+static int prio_expulsa(BCP * proc){
+    return proc->prioridad_efectiva > p_proc_actual->prioridad_efectiva;
+}
+
+/*
+ * Al crear un proceso el padre reparte su prioridad efectiva con el hijo
+ */
+static void prio_repartir(BCP * padre, BCP * hijo){
+    if(!padre)
+        return;
+    /* comprobamos las condiciones para repartir la prio_efectiva */
+    if(!(padre->prioridad == MIN_PRIO &&
+            padre->prioridad_efectiva <= MIN_PRIO)){
+        /* dividimos la prioridad del padre
+         * por que se repartira con el hijo 
+         */
+        padre->prioridad_efectiva /=  2;
+        recolocar_listo(padre);
+    }
+    // asignamos la prioridad efectiva al hijo
+    hijo->prioridad_efectiva = padre->prioridad_efectiva;
+}
+
+/*
+ * Ajusta la prioridad efectiva de un proceso al que le han cambiado
+ * la prioridad base
+ */
+static void prio_cambio_prio(BCP * proc, int prioridad_anterior){
+    int prioridad_efectiva_anterior = proc->prioridad_efectiva;
+
+    /* comprobamos las condiciones para asignar una prio_efectiva u otra */
+    if(proc->prioridad >= prioridad_anterior){
+        /* la prio_e = prio_e_ant * (prio + prio_ant) /(2 prio_ant)*/
+        proc->prioridad_efectiva *= ( (proc->prioridad + prioridad_anterior)/(prioridad_anterior * 2) );
+    }else{
+        /* La prio_e = prio_e_ant * (prio / prio_ant) evitando problemas con enteros*/
+        proc->prioridad_efectiva *= (proc->prioridad / (prioridad_anterior ));
+    }
+    LOG(LOG_INFO, LOG_PLANIF, "-> PROC %d, FIJANDO PRIORIDAD_E DE %d A %d\n",proc->id,
+            prioridad_efectiva_anterior, proc->prioridad_efectiva);
+
+    /* el proceso cambia de nivel en la cola de listos */
+    recolocar_listo(proc);
+}
+
+/*
+ * Politica stride (reparto proporcional). Cada tick que ejecuta, un
+ * proceso avanza su pase en una zancada inversamente proporcional a su
+ * prioridad base, y se ejecuta el de menor pase. Los listos se guardan
+ * en un monticulo ordenado por pase.
+ */
+static int antes_pase(BCP * a, BCP * b){
+	return a->pase < b->pase;
+}
+
 /*
- *
- * Funciones relacionadas con la tabla de procesos:
- *	iniciar_tabla_proc buscar_BCP_libre
- *
+ * Un proceso que vuelve de estar bloqueado no conserva el credito que
+ * tenia, parte como minimo del pase global
  */
+static void stride_encolar(BCP * proc){
+	if (proc->pase < pase_global)
+		proc->pase = pase_global;
+	proc->ticks_rodaja = RODAJA;
+	insertar_monticulo(&cola_stride, proc);
+}
+
+static void stride_desencolar(BCP * proc){
+	eliminar_monticulo(&cola_stride, proc);
+}
+
+static BCP * stride_elegir(){
+	return primero_monticulo(&cola_stride);
+}
 
 /*
- * Funcin que inicia la tabla de procesos
+ * Cobra el tick al proceso actual. Solo se comprueba si debe dejar la
+ * UCP al acabar su rodaja, para no cambiar de proceso en cada tick.
  */
-static void iniciar_tabla_proc(){
-	int i;
+static int stride_tick(){
+	p_proc_actual->pase += p_proc_actual->zancada;
+	actualizar_monticulo(&cola_stride, p_proc_actual);
+	pase_global = stride_elegir()->pase;
+	if (--p_proc_actual->ticks_rodaja > 0)
+		return 0;
+	p_proc_actual->ticks_rodaja = RODAJA;
+	return p_proc_actual != stride_elegir();
+}
 
-	for (i=0; i<MAX_PROC; i++)
-		tabla_procs[i].estado=NO_USADA;
+static int stride_expulsa(BCP * proc){
+	return proc->pase < p_proc_actual->pase;
 }
 
 /*
- * Funcin que busca una entrada libre en la tabla de procesos
+ * El hijo hereda la prioridad base del padre, y con ella su zancada, y
+ * empieza en el pase del padre para no adelantarle con credito extra
  */
-static int buscar_BCP_libre(){
-	int i;
+static void stride_repartir(BCP * padre, BCP * hijo){
+	hijo->zancada = ZANCADA_BASE / hijo->prioridad;
+	hijo->pase = padre ? padre->pase : pase_global;
+}
+
+/*
+ * Con la nueva prioridad cambia la zancada, y el pase que le quedaba por
+ * delante del pase global se escala en la misma proporcion
+ */
+static void stride_cambio_prio(BCP * proc, int prioridad_anterior){
+	unsigned long restante = 0;
+	unsigned long zancada_anterior = proc->zancada;
+
+	if (proc->pase > pase_global)
+		restante = proc->pase - pase_global;
+	proc->zancada = ZANCADA_BASE / proc->prioridad;
+	proc->pase = pase_global + restante * proc->zancada / zancada_anterior;
+	actualizar_monticulo(&cola_stride, proc);
+}
+
+/*
+ * Politica CFS (reparto justo). Cada tick que ejecuta, un proceso
+ * acumula tiempo virtual (vruntime) con un peso inversamente
+ * proporcional a su prioridad base, y se ejecuta el de menor vruntime.
+ * Los listos se guardan en un arbol rojinegro ordenado por vruntime.
+ */
+
+/*
+ * Un proceso que llega a la cola, p.ej. al despertar de lista_dormidos,
+ * parte como minimo del menor vruntime para no acaparar la UCP
+ */
+static void cfs_encolar(BCP * proc){
+	if (proc->vruntime < vruntime_minimo)
+		proc->vruntime = vruntime_minimo;
+	insertar_arbol(&cola_cfs, proc);
+}
+
+static void cfs_desencolar(BCP * proc){
+	eliminar_arbol(&cola_cfs, proc);
+}
+
+static BCP * cfs_elegir(){
+	return cola_cfs.minimo;
+}
+
+/*
+ * Cobra el tick al proceso actual. Deja la UCP cuando supera en mas de
+ * GRANULARIDAD_CFS al de menor vruntime.
+ */
+static int cfs_tick(){
+	eliminar_arbol(&cola_cfs, p_proc_actual);
+	p_proc_actual->vruntime += VRUNTIME_BASE / p_proc_actual->prioridad;
+	insertar_arbol(&cola_cfs, p_proc_actual);
+	if (cola_cfs.minimo->vruntime > vruntime_minimo)
+		vruntime_minimo = cola_cfs.minimo->vruntime;
+	return p_proc_actual->vruntime - cola_cfs.minimo->vruntime > GRANULARIDAD_CFS;
+}
+
+static int cfs_expulsa(BCP * proc){
+	return p_proc_actual->vruntime > proc->vruntime + GRANULARIDAD_CFS;
+}
+
+/*
+ * El hijo empieza en el vruntime del padre
+ */
+static void cfs_repartir(BCP * padre, BCP * hijo){
+	hijo->vruntime = padre ? padre->vruntime : vruntime_minimo;
+}
+
+/*
+ * Politica MLFQ (colas multinivel con realimentacion). Hay NIVELES_MLFQ
+ * colas FIFO, el nivel 0 es el mas prioritario y la rodaja crece con el
+ * nivel. Un proceso que agota su rodaja baja de nivel y uno que se
+ * bloquea antes de agotarla sube. Cada PERIODO_SUBIDA_MLFQ ticks todos
+ * vuelven al nivel 0 para que no haya inanicion.
+ */
+
+/*
+ * Retorna el nivel de un proceso. Si no ha visto la ultima subida
+ * general es que esta en el nivel 0.
+ */
+static int nivel_mlfq(BCP * proc){
+	if (proc->epoca_mlfq != epoca_mlfq){
+		proc->epoca_mlfq = epoca_mlfq;
+		proc->nivel_mlfq = 0;
+	}
+	return proc->nivel_mlfq;
+}
+
+/*
+ * Sube todos los listos al nivel 0 concatenando las colas, con la
+ * rodaja de ese nivel, tambien el que esta en ejecucion. Los
+ * bloqueados se enteran al consultar su nivel.
+ */
+static void subir_todos_mlfq(){
+	BCP *proc;
+	int nivel;
+
+	LOG(LOG_INFO, LOG_PLANIF, "-> SUBIDA GENERAL DE NIVEL MLFQ\n");
+	for (nivel = 1; nivel < NIVELES_MLFQ; nivel++){
+		for (proc = colas_mlfq[nivel].primero; proc; proc = proc->siguiente)
+			proc->ticks_rodaja = RODAJA_MLFQ(0);
+		concatenar_listas(&colas_mlfq[0], &colas_mlfq[nivel]);
+	}
+	p_proc_actual->ticks_rodaja = RODAJA_MLFQ(0);
+	epoca_mlfq++;
+	ticks_subida_mlfq = 0;
+}
+
+static void mlfq_encolar(BCP * proc){
+	int nivel = nivel_mlfq(proc);
+
+	proc->ticks_rodaja = RODAJA_MLFQ(nivel);
+	insertar_ultimo(&colas_mlfq[nivel], proc);
+}
+
+/*
+ * Si sale de la cola porque se bloquea sin haber agotado ninguna rodaja
+ * desde la vez anterior sube un nivel. Al terminar o cambiar de clase
+ * no cambia de nivel.
+ */
+static void mlfq_desencolar(BCP * proc){
+	int nivel = nivel_mlfq(proc);
+
+	eliminar_elem(&colas_mlfq[nivel], proc);
+	if (proc->estado == BLOQUEADO){
+		if (!proc->agoto_rodaja_mlfq && (nivel > 0))
+			proc->nivel_mlfq = nivel - 1;
+		proc->agoto_rodaja_mlfq = 0;
+	}
+}
+
+static BCP * mlfq_elegir(){
+	int nivel;
+
+	for (nivel = 0; nivel < NIVELES_MLFQ; nivel++)
+		if (colas_mlfq[nivel].primero)
+			return colas_mlfq[nivel].primero;
+	return NULL;
+}
+
+/*
+ * Cobra el tick al proceso actual, que baja de nivel si agota su rodaja
+ */
+static int mlfq_tick(){
+	int nivel;
+
+	if (++ticks_subida_mlfq >= PERIODO_SUBIDA_MLFQ){
+		subir_todos_mlfq();
+		return 1;
+	}
+	if (--p_proc_actual->ticks_rodaja > 0)
+		return 0;
+
+	nivel = nivel_mlfq(p_proc_actual);
+	LOG(LOG_DEPURACION, LOG_PLANIF, "-> PROCESO %d AGOTA SU RODAJA EN NIVEL %d\n",
+		p_proc_actual->id, nivel);
+	eliminar_elem(&colas_mlfq[nivel], p_proc_actual);
+	p_proc_actual->agoto_rodaja_mlfq = 1;
+	if (nivel < NIVELES_MLFQ - 1)
+		p_proc_actual->nivel_mlfq = nivel + 1;
+	mlfq_encolar(p_proc_actual);
+	return 1;
+}
+
+/*
+ * Un proceso despertado expulsa al actual si esta en un nivel mas alto
+ */
+static int mlfq_expulsa(BCP * proc){
+	return nivel_mlfq(proc) < nivel_mlfq(p_proc_actual);
+}
 
-	for (i=0; i<MAX_PROC; i++)
-		if (tabla_procs[i].estado==NO_USADA)
-			return i;
-	return -1;
+/*
+ * Los procesos nuevos empiezan en el nivel 0
+ */
+static void mlfq_repartir(BCP * padre, BCP * hijo){
+	hijo->nivel_mlfq = 0;
+	hijo->epoca_mlfq = epoca_mlfq;
+	hijo->agoto_rodaja_mlfq = 0;
 }
 
+/*
+ * Tabla de politicas de planificacion disponibles, indexada por PLANIF_*
+ */
+static politica_planif politicas[NUM_POLITICAS]={
+	{"fifo", fifo_encolar, fifo_desencolar, fifo_elegir, fifo_tick,
+		fifo_expulsa, fifo_repartir, fifo_cambio_prio},
+	{"rr", rr_encolar, fifo_desencolar, fifo_elegir, rr_tick,
+		fifo_expulsa, fifo_repartir, fifo_cambio_prio},
+	{"prio", insertar_listo, eliminar_listo, maxima_prioridad, prio_tick,
+		prio_expulsa, prio_repartir, prio_cambio_prio, prio_reajustar},
+	{"stride", stride_encolar, stride_desencolar, stride_elegir, stride_tick,
+		stride_expulsa, stride_repartir, stride_cambio_prio},
+	{"cfs", cfs_encolar, cfs_desencolar, cfs_elegir, cfs_tick,
+		cfs_expulsa, cfs_repartir, fifo_cambio_prio},
+	{"mlfq", mlfq_encolar, mlfq_desencolar, mlfq_elegir, mlfq_tick,
+		mlfq_expulsa, mlfq_repartir, fifo_cambio_prio}};
+
 /*
  *
- * Funciones que facilitan el manejo de las listas de BCPs
- *	insertar_ultimo eliminar_primero eliminar_elem
+ * Funciones de la clase de tiempo real EDF
+ *	tr_encolar tr_desencolar tr_tick tr_reponer expulsa_actual
+ *	actualizar_mejor_listo
+ *
+ * Los procesos registrados con fijar_tiempo_real van por delante de la
+ * politica normal y se eligen por plazo absoluto mientras les quede
+ * presupuesto en el periodo. Cada trabajo acaba cuando el proceso se
+ * bloquea; si agota el presupuesto antes espera en cola_reposicion
+ * hasta el siguiente periodo.
  *
- * NOTA: PRIMERO SE DEBE LLAMAR A eliminar Y LUEGO A insertar
  */
+static int antes_plazo(BCP * a, BCP * b){
+	return a->plazo_abs < b->plazo_abs;
+}
+
+static int antes_periodo(BCP * a, BCP * b){
+	return a->proximo_periodo < b->proximo_periodo;
+}
 
 /*
- * Inserta un BCP al final de la lista.
+ * Empieza un nuevo trabajo del proceso en el tick inicio
  */
-static void insertar_ultimo(lista_BCPs *lista, BCP * proc){
-	if (lista->primero==NULL)
-		lista->primero= proc;
-	else
-		lista->ultimo->siguiente=proc;
-	lista->ultimo= proc;
-	proc->siguiente=NULL;
+static void tr_nuevo_trabajo(BCP * proc, unsigned long inicio){
+	proc->plazo_abs = inicio + proc->plazo;
+	proc->proximo_periodo = inicio + proc->periodo;
+	proc->presupuesto_restante = proc->presupuesto;
+	proc->trabajo_pendiente = 1;
 }
 
 /*
- * Elimina el primer BCP de la lista.
+ * Da por acabado el trabajo actual contando si ha perdido su plazo
  */
-static void eliminar_primero(lista_BCPs *lista){
+static void tr_fin_trabajo(BCP * proc){
+	if (proc->trabajo_pendiente && ticks_sistema > proc->plazo_abs){
+		proc->fallos_plazo++;
+		LOG(LOG_AVISO, LOG_PLANIF, "-> PROC %d PIERDE SU PLAZO\n", proc->id);
+	}
+	proc->trabajo_pendiente = 0;
+}
 
-	if (lista->ultimo==lista->primero)
-		lista->ultimo=NULL;
-	lista->primero=lista->primero->siguiente;
+/*
+ * Si vuelve de bloquearse antes de su siguiente periodo espera a que
+ * llegue, si no empieza un trabajo nuevo
+ */
+static void tr_encolar(BCP * proc){
+	if (!proc->trabajo_pendiente){
+		if (ticks_sistema < proc->proximo_periodo){
+			proc->esperando_periodo = 1;
+			insertar_monticulo(&cola_reposicion, proc);
+			return;
+		}
+		tr_nuevo_trabajo(proc, ticks_sistema);
+	}
+	proc->esperando_periodo = 0;
+	insertar_monticulo(&cola_edf, proc);
+}
+
+static void tr_desencolar(BCP * proc){
+	if (proc->esperando_periodo)
+		eliminar_monticulo(&cola_reposicion, proc);
+	else
+		eliminar_monticulo(&cola_edf, proc);
+	proc->esperando_periodo = 0;
+	tr_fin_trabajo(proc);
 }
 
 /*
- * Elimina un determinado BCP de la lista.
+ * Descuenta un tick del presupuesto del actual; al agotarlo deja la UCP
+ * hasta su siguiente periodo
  */
-static void eliminar_elem(lista_BCPs *lista, BCP * proc){
-	BCP *paux=lista->primero;
+static int tr_tick(){
+	if (p_proc_actual->esperando_periodo)
+		return 0;
+	if (--p_proc_actual->presupuesto_restante > 0)
+		return 0;
+	LOG(LOG_DEPURACION, LOG_PLANIF, "-> PROC %d AGOTA SU PRESUPUESTO\n", p_proc_actual->id);
+	eliminar_monticulo(&cola_edf, p_proc_actual);
+	p_proc_actual->esperando_periodo = 1;
+	insertar_monticulo(&cola_reposicion, p_proc_actual);
+	return 1;
+}
 
-	if (paux==proc)
-		eliminar_primero(lista);
-	else {
-		for ( ; ((paux) && (paux->siguiente!=proc));
-			paux=paux->siguiente);
-		if (paux) {
-			if (lista->ultimo==paux->siguiente)
-				lista->ultimo=paux;
-			paux->siguiente=paux->siguiente->siguiente;
+/*
+ * Indica si proc, que acaba de pasar a listo, debe expulsar al actual
+ */
+static int expulsa_actual(BCP * proc){
+	if (proc->clase==CLASE_TR)
+		return (p_proc_actual->clase!=CLASE_TR) ||
+			(proc->plazo_abs < p_proc_actual->plazo_abs);
+	if (p_proc_actual->clase==CLASE_TR)
+		return 0;
+	return planif->expulsa(proc);
+}
+
+/*
+ * Empieza el trabajo de los procesos cuyo periodo ha llegado. Si el
+ * anterior no habia acabado ha perdido su plazo. Devuelve 1 si alguno
+ * debe expulsar al actual.
+ */
+static int tr_reponer(){
+	BCP *proc;
+	int expulsa = 0;
+
+	while ((proc=primero_monticulo(&cola_reposicion)) &&
+			proc->proximo_periodo <= ticks_sistema){
+		eliminar_monticulo(&cola_reposicion, proc);
+		proc->esperando_periodo = 0;
+		if (proc->trabajo_pendiente){
+			proc->fallos_plazo++;
+			LOG(LOG_AVISO, LOG_PLANIF, "-> PROC %d PIERDE SU PLAZO\n", proc->id);
 		}
+		tr_nuevo_trabajo(proc, proc->proximo_periodo);
+		insertar_monticulo(&cola_edf, proc);
+		if (expulsa_actual(proc))
+			expulsa = 1;
+		actualizar_mejor_listo();
 	}
+	return expulsa;
+}
+
+/*
+ * Recalcula mejor_listo, el proceso a ejecutar: el de menor plazo de
+ * tiempo real o, si no hay ninguno, el que elija la politica normal. Se
+ * invoca tras cada cambio en las colas de listos, de modo que comprobar
+ * si el actual debe seguir es una sola comparacion.
+ */
+static void actualizar_mejor_listo(){
+	BCP *proc;
+
+	if ((proc=primero_monticulo(&cola_edf)))
+		mejor_listo = proc;
+	else
+		mejor_listo = planif->elegir();
+}
+
+/*
+ * Funcion auxiliar que muestra los datos mas relevantes de un proceso
+ */
+static void muestra_proceso(BCP *paux){
+    printk("\nProceso id %d {\n",paux->id);
+    printk("\tEstado: ");
+
+    if (paux->estado == TERMINADO) printk("TERMINADO");
+    else if (paux->estado == LISTO) printk("LISTO");
+    else if (paux->estado == EJECUCION) printk("EJECUCION");
+    else if (paux->estado == BLOQUEADO) printk ("BLOQUEADO");
+    printk("\n");
+
+    printk("\tPrioridad: %d;\n",paux->prioridad);
+    printk("\tPrioridad_E: %d;\n",paux->prioridad_efectiva);
+    printk("}\n");
 }
 
 /*
@@ -99,6 +1478,21 @@ static void eliminar_elem(lista_BCPs *lista, BCP * proc){
 static void muestra_lista(lista_BCPs *lista){
 	BCP *paux=lista->primero;
     int cierre_lista = 0;
+    int i;
+
+    /* solo en las versiones de depuracion del planificador */
+    if(!LOG_ACTIVO(LOG_DEPURACION, LOG_PLANIF)) return;
+    vaciar_consola();
+
+    /* la cola de listos depende de la politica, se buscan en la tabla */
+    if(lista == &lista_listos){
+        printk("\n== LISTA DE PROCESOS LISTOS\n");
+        for(i = 0; i < capacidad_procs; i++)
+            if(tabla_procs[i]->estado == LISTO || tabla_procs[i]->estado == EJECUCION)
+                muestra_proceso(tabla_procs[i]);
+        printk("== FIN LISTA\n\n");
+        return;
+    }
     /* Si hay un proceso mostramos que tipo de lista es mediante su estado */
     /* recorremos la lista mientras hayan procesos */
     if(paux){
@@ -109,20 +1503,7 @@ static void muestra_lista(lista_BCPs *lista){
         printk("\n");
     }
     while(paux){
-        printk("\nProceso id %d {\n",paux->id);
-        printk("\tEstado: ");
-
-        if(paux){
-            if (paux->estado == TERMINADO) printk("TERMINADO");
-            else if (paux->estado == LISTO) printk("LISTO");
-            else if (paux->estado == EJECUCION) printk("EJECUCION");
-            else if (paux->estado == BLOQUEADO) printk ("BLOQUEADO");
-            printk("\n");
-        }
-
-        printk("\tPrioridad: %d;\n",paux->prioridad);
-        printk("\tPrioridad_E: %d;\n",paux->prioridad_efectiva);
-        printk("}\n");
+        muestra_proceso(paux);
         paux = paux->siguiente;
     }
     if(cierre_lista)
@@ -134,87 +1515,169 @@ static void muestra_lista(lista_BCPs *lista){
 /*
  *
  * Funciones relacionadas con la planificacion
- *	espera_int planificador
+ *	espera_int planificador pasar_a_listo pasar_a_ejecucion
  */
 
 
+static int volcar_consola(unsigned int max);
+static int consola_pendiente();
+
 /*
- * Espera a que se produzca una interrupcion
+ * Espera a que se produzca una interrupcion. Si hay salida de consola
+ * pendiente se aprovecha para volcarla entera en vez de esperar.
  */
 static void espera_int(){
 	int nivel;
 
-	printk("-> NO HAY LISTOS. ESPERA INT\n");
+	if (consola_pendiente()){
+		volcar_consola(TAM_CONSOLA);
+		return;
+	}
+	TRAZA(EV_ESPERA_INT, -1, 0, 0);
 
 	/* Baja al mnimo el nivel de interrupcin mientras espera */
 	nivel=fijar_nivel_int(NIVEL_1);
+	en_espera_int = 1;
 	halt();
+	en_espera_int = 0;
 	fijar_nivel_int(nivel);
 }
 
+/*
+ * Funciones que mantienen la lista de hijos vivos de cada proceso, para
+ * no recorrer la tabla de procesos al terminar
+ */
+static void anadir_hijo(BCP *padre, BCP *hijo){
+    hijo->hermano_ant = NULL;
+    hijo->hermano_sig = padre->primer_hijo;
+    if (padre->primer_hijo)
+        padre->primer_hijo->hermano_ant = hijo;
+    padre->primer_hijo = hijo;
+}
+
+static void quitar_hijo(BCP *padre, BCP *hijo){
+    if (hijo->hermano_ant)
+        hijo->hermano_ant->hermano_sig = hijo->hermano_sig;
+    else
+        padre->primer_hijo = hijo->hermano_sig;
+    if (hijo->hermano_sig)
+        hijo->hermano_sig->hermano_ant = hijo->hermano_ant;
+    hijo->hermano_sig = hijo->hermano_ant = NULL;
+}
+
 /* *
  *Funcion que asigna a los hijos del proceso actual la id_padre ID_HUERFANO
+ * y lo saca de la lista de hijos de su padre
  * */
 static void tratar_hijos(){
-    int  contador;
-    printk("-> TRATANDO HIJOS DEL PROCESO %i\n", p_proc_actual->id);
-    for(contador = 0; contador < MAX_PROC; contador++){
-        /* comprobamos que en el BCP hay un proceso */
-        if(tabla_procs[contador].estado != NO_USADA){
-            /*  comprobamos que es hijo del proceso actual */
-            if(tabla_procs[contador].id_padre == p_proc_actual->id)
-                tabla_procs[contador].id_padre = ID_HUERFANO;
-        }
+    BCP *hijo;
+
+    LOG(LOG_DEPURACION, LOG_PROC, "-> TRATANDO HIJOS DEL PROCESO %i\n", p_proc_actual->id);
+    while ((hijo = p_proc_actual->primer_hijo)){
+        quitar_hijo(p_proc_actual, hijo);
+        hijo->id_padre = ID_HUERFANO;
     }
+    if (p_proc_actual->id_padre != ID_HUERFANO)
+        quitar_hijo(tabla_procs[p_proc_actual->id_padre], p_proc_actual);
 }
 
 /*
- * funcion actual que reajusta las prioridades de todos los procesos si es necesario
+ * Funcin de planificacion, elige el proceso segun la politica activa.
  */
-static void reajustar_prioridades(){
-    int  contador, prioridad;
-    int prioridad_e;
-    printk("NECESARIO REAJUSTE GLOBAL DE PRIORIDADES\n");
-    for(contador = 0; contador < MAX_PROC; contador++){
-        /* comprobamos que en el BCP hay un proceso */
-        if(tabla_procs[contador].estado != NO_USADA){
-            prioridad_e = tabla_procs[contador].prioridad_efectiva;
-            prioridad = tabla_procs[contador].prioridad;
-            tabla_procs[contador].prioridad_efectiva = (prioridad_e / 2) + prioridad;
-        }
-    }
+static BCP * planificador(){
+	BCP * proc;
+	int nivel;
 
+    /*  la planificacion depende de la politica elegida al arrancar */
+	while (mejor_listo==NULL)
+		espera_int();		/* No hay nada que hacer */
+	nivel=fijar_nivel_int(NIVEL_3);
+	if (planif->reajustar){
+		planif->reajustar();
+		actualizar_mejor_listo();
+	}
+	proc=mejor_listo;
+	fijar_nivel_int(nivel);
+	return proc;
 }
 
-/* 
- *Funcion que retorna el proceso con maxima prioridad
- */
-static BCP * maxima_prioridad(lista_BCPs *lista){
-    BCP * paux, * max_prio;
-    paux = lista->primero;
-    max_prio = paux;
-    /* recorremos la lista y nos quedamos con el proceso con max_prio */
-    while(paux->siguiente){
-        paux = paux->siguiente;
-        if(paux->prioridad_efectiva > max_prio->prioridad_efectiva) max_prio = paux;
-    }
-    /* si la maxima prioridad del proceso es 0, es necesario reajuste */
-    if(max_prio->prioridad_efectiva == 0){
-        reajustar_prioridades();
-        return maxima_prioridad(lista);
+/*
+ * Funcion que anota una latencia de despertar en un histograma
+ */
+static void anotar_latencia(histograma_latencia *h, unsigned long us){
+    int cubeta;
+
+    cubeta = us ? (int)(8*sizeof(long)) - __builtin_clzl(us) : 0;
+    if (cubeta >= NUM_CUBETAS_LATENCIA)
+        cubeta = NUM_CUBETAS_LATENCIA - 1;
+    h->cubetas[cubeta]++;
+    h->num++;
+    if (us > h->maximo)
+        h->maximo = us;
+}
+
+/*
+ * Funcion que pasa un proceso a listo apuntando cuando lo hace
+ */
+static void pasar_a_listo(BCP * proc){
+    proc->estado = LISTO;
+    proc->tick_listo = ticks_sistema;
+}
+
+/*
+ * Funcion que pasa un proceso a ejecucion sumando a su uso los ticks que
+ * ha esperado como listo
+ */
+static void pasar_a_ejecucion(BCP * proc){
+    unsigned long latencia;
+
+    proc->estado = EJECUCION;
+    proc->uso.ticks_espera += ticks_sistema - proc->tick_listo;
+
+    /* la pagina de datos pasa a ser la del nuevo proceso */
+    pagina_datos.pid = proc->id;
+    pagina_datos.ppid = proc->id_padre;
+    pagina_datos.prioridad = proc->prioridad;
+
+    /* si viene de despertar anotamos cuanto ha tardado en ejecutar */
+    if (proc->us_despertar){
+        latencia = reloj_us() - proc->us_despertar;
+        anotar_latencia(&latencia_global, latencia);
+        anotar_latencia(&latencia_prio[proc->prioridad - MIN_PRIO], latencia);
+        proc->us_despertar = 0;
     }
+}
 
-    return max_prio;
+/*
+ * Funcion que suma los contadores de uso origen a los de destino
+ */
+static void sumar_uso(contadores_uso *destino, contadores_uso *origen){
+    destino->ticks_usuario += origen->ticks_usuario;
+    destino->ticks_nucleo += origen->ticks_nucleo;
+    destino->ticks_espera += origen->ticks_espera;
+    destino->cambios_voluntarios += origen->cambios_voluntarios;
+    destino->cambios_involuntarios += origen->cambios_involuntarios;
 }
 
 /*
- * Funcin de planificacion que implementa un algoritmo FIFO.
+ * Elige la politica de planificacion al arrancar: POLITICA_PLANIF o la
+ * indicada por nombre en la variable de entorno MINIKERNEL_PLANIF
  */
-static BCP * planificador(){
-	while (lista_listos.primero==NULL)
-		espera_int();		/* No hay nada que hacer */
-    /*  la plainificacion actual se base en la busqueda de maxima_prioridad */
-	return maxima_prioridad(&lista_listos);
+static void iniciar_planificacion(){
+	char *nombre;
+	int i;
+
+	iniciar_monticulo(&cola_stride, antes_pase);
+	iniciar_monticulo(&cola_edf, antes_plazo);
+	iniciar_monticulo(&cola_reposicion, antes_periodo);
+
+	planif=&politicas[POLITICA_PLANIF];
+	nombre=getenv("MINIKERNEL_PLANIF");
+	if (nombre)
+		for (i=0; i<NUM_POLITICAS; i++)
+			if (strcmp(nombre, politicas[i].nombre)==0)
+				planif=&politicas[i];
+	LOG(LOG_AVISO, LOG_PLANIF, "-> POLITICA DE PLANIFICACION: %s\n", planif->nombre);
 }
 
 /*
@@ -229,28 +1692,53 @@ static void liberar_proceso(){
     /* detenemos interrupciones */
 	nivel=fijar_nivel_int(NIVEL_3); /*nivel 3 detiene todas */
 
-    /* modificamos la id_padre de los hijos a huerfano */
+    TRAZA(EV_TERMINAR, p_proc_actual->id, 0, 0);
+
+    /* modificamos la id_padre de los hijos a huerfano y lo sacamos de
+     * los hijos de su padre */
     tratar_hijos();
 
+    /* su uso y el de sus hijos se acumula en el padre */
+    if (p_proc_actual->id_padre != ID_HUERFANO){
+        sumar_uso(&tabla_procs[p_proc_actual->id_padre]->uso_hijos,
+                &p_proc_actual->uso);
+        sumar_uso(&tabla_procs[p_proc_actual->id_padre]->uso_hijos,
+                &p_proc_actual->uso_hijos);
+    }
+
+    /* al liberar la imagen del ultimo proceso termina la simulacion,
+     * antes se vacia la consola y se vuelca la traza */
+    if (--num_procesos == 0){
+        volcar_consola(TAM_CONSOLA);
+        LOG(LOG_INFO, LOG_PROC, "-> NO QUEDAN PROCESOS\n");
+        LOG(LOG_INFO, LOG_PROC, "-> TICKS OCIOSOS: %lu\n", ticks_ociosos);
+        if (traza_activa)
+            volcar_traza();
+    }
+
 	liberar_imagen(p_proc_actual->info_mem); /* liberar mapa */
+	cancelar_temporizador(&p_proc_actual->temp_dormir);
 
 	p_proc_actual->estado=TERMINADO;
 	//eliminar_primero(&lista_listos); /* proc. fuera de listos */
 	
     eliminar_elem(&lista_listos, p_proc_actual); /* proc. fuera de listos */
+    /* devolvemos su reserva de tiempo real */
+    if (p_proc_actual->clase == CLASE_TR)
+        utilizacion_tr -= p_proc_actual->densidad;
+    /* su entrada vuelve a las libres */
+    liberar_BCP(p_proc_actual);
     p_proc_anterior=p_proc_actual;
 	p_proc_actual=planificador();
 
 	
     /* Realizar cambio de contexto */
-    //muestra_lista(&lista_listos);
-	printk("-> C.CONTEXTO POR FIN: de %d a %d\n",
-			p_proc_anterior->id, p_proc_actual->id);
+	TRAZA(EV_CAMBIO_CONTEXTO, p_proc_anterior->id, p_proc_actual->id, CC_FIN);
 
     /* Cancelamos la replanificacion que pueda haber pendiente */
     replanificacion_pendiente = 0;
 	liberar_pila(p_proc_anterior->pila);
-    p_proc_actual->estado=EJECUCION;
+    pasar_a_ejecucion(p_proc_actual);
     /*  volvemos a poner interrupciones como antes */
 	fijar_nivel_int(nivel);
     /*  realizamos el cambio de contexto */
@@ -275,6 +1763,8 @@ static void bloquear(lista_BCPs * lista){
 
     /* bloqueamos el proceso y apuntamos a el */
     p_proc_actual->estado=BLOQUEADO;
+    TRAZA(EV_BLOQUEO, p_proc_actual->id, 0, 0);
+    p_proc_actual->uso.cambios_voluntarios++;
     p_proc_anterior=p_proc_actual;
 
 
@@ -286,18 +1776,14 @@ static void bloquear(lista_BCPs * lista){
     /* llamamos al planificador para recuperar el nuevo proceso */
     p_proc_actual=planificador();
 
-	printk("-> C.CONTEXTO POR BLOQUEO: de %d a %d\n",
-			p_proc_anterior->id, p_proc_actual->id);
+	TRAZA(EV_CAMBIO_CONTEXTO, p_proc_anterior->id, p_proc_actual->id,
+			CC_BLOQUEO);
 
     /* Cancelamos la replanificacion que pueda haber pendiente */
     replanificacion_pendiente = 0;
     
-    p_proc_actual->estado=EJECUCION;
+    pasar_a_ejecucion(p_proc_actual);
 
-    /* Mostramos lista listos */
-    muestra_lista(&lista_listos);
-    /* Mostramos lista dormidos */
-    muestra_lista(&lista_dormidos);
     /*  volvemos a poner interrupciones como antes */
 	fijar_nivel_int(nivel);
     /*  realizamos el cambio de contexto */
@@ -309,99 +1795,251 @@ static void bloquear(lista_BCPs * lista){
 
 
 /*
- * Funcion auxiliar que pone desbloquea de la lista que recibeo 
- * y lo inserta en la lista listos
- *
+ * Funcion auxiliar que modifica el proceso actual por el que retorna
+ * el planificador
+ */
+static void replanificar(){
+    BCP * p_proc_anterior, *p_proc_nuevo;
+    int nivel;
+    /* detenemos interrupciones */
+	nivel=fijar_nivel_int(NIVEL_3); /*nivel 3 detiene todas */
+    
+    /* comprobamos que el planificador no nos retorna el mismo proceso
+     * que el actual, si es asi no es necesario replanificar*/
+    p_proc_nuevo = planificador();
+    if(p_proc_nuevo == p_proc_actual){
+        replanificacion_pendiente = 0;
+        fijar_nivel_int(nivel);
+        return;
+    }
+
+    /*  ponemos le proceso actual de EJECUCION a LISTO */
+    pasar_a_listo(p_proc_actual);
+    p_proc_actual->uso.cambios_involuntarios++;
+    p_proc_anterior = p_proc_actual;
+    /* recuperamos el proceso segun el planificador */
+    p_proc_actual = p_proc_nuevo;
+
+    
+    TRAZA(EV_CAMBIO_CONTEXTO, p_proc_anterior->id, p_proc_actual->id,
+        CC_REPLANIFICACION);
+    
+    /* Cancelamos la replanificacion que pueda haber pendiente */
+    replanificacion_pendiente = 0;
+
+    pasar_a_ejecucion(p_proc_actual);
+    
+	fijar_nivel_int(nivel);
+    /* realizamos el cambio de contexto */
+    cambio_contexto(&(p_proc_anterior->contexto_regs), 
+            &(p_proc_actual->contexto_regs));
+    return /* no deberia llegar aqui */;
+}
+/*
+ * Funcion que vence el temporizador de un proceso dormido y lo pasa al
+ * lote de despertados del tick. Se invoca desde la interrupcion de reloj.
+ */
+static void despertar(void *arg){
+    BCP *proc = arg;
+
+    LOG(LOG_DEPURACION, LOG_TEMPOR, "-> DESPERTANDO PROC: %d\n", proc->id);
+    eliminar_elem(&lista_dormidos, proc);
+    insertar_ultimo(&lista_despertados, proc);
+}
+
+/*
+ * Funcion que pasa a listos todos los procesos de una lista de
+ * bloqueados, como los despertados en este tick, en una sola seccion con
+ * interrupciones inhibidas. Todo despertar pasa por aqui y aqui se traza.
+ * Devuelve 1 si alguno debe expulsar al actual.
+ */
+static int despertar_lista(lista_BCPs *lista){
+    BCP *proc;
+    int nivel, expulsa = 0;
+    unsigned long ahora;
+
+    if(!lista->primero) return 0;
+
+    ahora = reloj_us();
+    nivel=fijar_nivel_int(NIVEL_3);
+    while((proc = lista->primero)){
+        eliminar_primero(lista);
+        TRAZA(EV_DESPERTAR, proc->id, 0, 0);
+        pasar_a_listo(proc);
+        proc->us_despertar = ahora;
+        insertar_ultimo(&lista_listos, proc);
+        if(!expulsa && expulsa_actual(proc))
+            expulsa = 1;
+    }
+    fijar_nivel_int(nivel);
+
+    return expulsa;
+}
+
+/*
+ *
+ * Funciones de la consola asincrona
+ *	sacar_consola vaciar_consola volcar_consola consola_pendiente
+ *	panico_nucleo
+ *
+ * escribir copia en el anillo consola y vuelve sin esperar a la
+ * pantalla, salvo que el anillo este lleno, en cuyo caso el proceso se
+ * bloquea en lista_consola hasta que haya hueco. El anillo se vuelca
+ * entero cuando no hay nada que ejecutar (espera_int) y a trozos de
+ * DRENAJE_CONSOLA en la interrupcion software que se pide en cada tick
+ * con salida pendiente; al terminar el ultimo proceso o en un panico se
+ * vacia antes de parar. Los mensajes del nucleo (LOG, la traza y las
+ * listas de procesos) vacian antes el anillo para mantener el orden;
+ * como pueden salir en mitad de una operacion con las listas, no
+ * despiertan a los escritores, que lo hace el siguiente volcado.
+ *
+ */
+
+/*
+ * Saca en orden hasta max bytes del anillo a la pantalla
+ */
+static void sacar_consola(unsigned int max){
+    unsigned long pendientes, inicio, trozo;
+    int nivel;
+
+    nivel=fijar_nivel_int(NIVEL_3);
+    pendientes = consola_escritos - consola_volcados;
+    if (pendientes > max)
+        pendientes = max;
+    while (pendientes > 0){
+        /* hasta el final del anillo de una vez */
+        inicio = consola_volcados & (TAM_CONSOLA - 1);
+        trozo = TAM_CONSOLA - inicio;
+        if (trozo > pendientes)
+            trozo = pendientes;
+        escribir_ker(&consola[inicio], trozo);
+        consola_volcados += trozo;
+        pendientes -= trozo;
+    }
+    fijar_nivel_int(nivel);
+}
+
+/*
+ * Saca todo el anillo a la pantalla antes de un mensaje del nucleo
+ */
+static void vaciar_consola(){
+    sacar_consola(TAM_CONSOLA);
+}
+
+/*
+ * Vuelca hasta max bytes del anillo y despierta a los escritores que
+ * esperaban hueco. Devuelve 1 si alguno debe expulsar al actual.
+ */
+static int volcar_consola(unsigned int max){
+    sacar_consola(max);
+    return despertar_lista(&lista_consola);
+}
+
+/*
+ * Indica si queda algo por volcar o escritores esperando hueco
  */
-static void desbloquear(BCP * proc, lista_BCPs * lista){
-    int nivel;
-    
-    /* lo marcamos como listo */
-    proc->estado = LISTO;    
-    nivel=fijar_nivel_int(NIVEL_3);
-    eliminar_elem(lista, proc); /* lo eliminamos de la lista de bloqueados */
-    insertar_ultimo(&lista_listos, proc); /* lo insertamos como listo */
-    fijar_nivel_int(nivel);
-    
-    /* si no hay una replanificacion pendiente, comprobamos si es necesaria */
-    if(!replanificacion_pendiente){
-        /* comprobamos la prioridad del nuevo proceso */
-        if(proc->prioridad_efectiva > p_proc_actual->prioridad_efectiva){
-            /* activamos la interrupcion con la replanificacion pendiente */
-            replanificacion_pendiente = 1;
-            activar_int_SW();
-        }
-    }
+static int consola_pendiente(){
+    return consola_escritos != consola_volcados || lista_consola.primero;
+}
 
-    return;
+/*
+ * Termina el sistema con un mensaje como panico, pero sin perder la
+ * salida que quede en la consola
+ */
+static void panico_nucleo(char *mens){
+    fijar_nivel_int(NIVEL_3);
+    volcar_consola(TAM_CONSOLA);
+    panico(mens);
 }
 
 /*
- * Funcion auxiliar que modifica el proceso actual por el que retorna
- * el planificador
+ *
+ * Funciones del terminal
+ *	eco_terminal recibir_caracter vencer_lectura leer_terminal
+ *
+ * int_terminal pasa cada caracter por la disciplina de linea y despierta
+ * directamente a los procesos bloqueados en lista_terminal, que no
+ * gastan UCP mientras esperan. En modo canonico la linea en edicion
+ * (de terminal_disponibles a terminal_recibidos) admite borrado y tiene
+ * eco, y solo se puede leer al llegar su fin de linea o llenar el
+ * anillo; en modo crudo cada caracter se puede leer segun llega, sin
+ * eco. Si el anillo esta lleno el caracter se pierde.
+ *
  */
-static void replanificar(){
-    BCP * p_proc_anterior, *p_proc_nuevo;
-    int nivel;
-    /* detenemos interrupciones */
-	nivel=fijar_nivel_int(NIVEL_3); /*nivel 3 detiene todas */
-    
-    /* comprobamos que el planificador no nos retorna el mismo proceso
-     * que el actual, si es asi no es necesario replanificar*/
-    p_proc_nuevo = planificador();
-    if(p_proc_nuevo == p_proc_actual) return;
 
-    /*  ponemos le proceso actual de EJECUCION a LISTO */
-    p_proc_actual->estado=LISTO;
-    p_proc_anterior = p_proc_actual;
-    /* recuperamos el proceso segun el planificador */
-    p_proc_actual = p_proc_nuevo;
+/*
+ * Copia el eco en el anillo de la consola si cabe; desde una
+ * interrupcion no se puede esperar a que haya hueco
+ */
+static void eco_terminal(char *texto, int longi){
+    if (TAM_CONSOLA - (consola_escritos - consola_volcados) < (unsigned long)longi)
+        return;
+    while (longi-- > 0)
+        consola[consola_escritos++ & (TAM_CONSOLA - 1)] = *texto++;
+}
 
-    
-    printk("-> C.CONTEXTO POR REPLANIFICACION: de %d a %d\n",
-        p_proc_anterior->id, p_proc_actual->id);
-    
-    /* Cancelamos la replanificacion que pueda haber pendiente */
-    replanificacion_pendiente = 0;
+/*
+ * Aplica la disciplina de linea a un caracter recibido. Devuelve 1 si
+ * hay caracteres nuevos que leer.
+ */
+static int recibir_caracter(char car){
+    if (modo_terminal == TERMINAL_CANONICO){
+        if (car == CAR_BORRAR || car == CAR_SUPRIMIR){
+            if (terminal_recibidos > terminal_disponibles){
+                terminal_recibidos--;
+                eco_terminal("\b \b", 3);
+            }
+            return 0;
+        }
+        if (car == CAR_MATAR_LINEA){
+            while (terminal_recibidos > terminal_disponibles){
+                terminal_recibidos--;
+                eco_terminal("\b \b", 3);
+            }
+            return 0;
+        }
+    }
 
-    p_proc_actual->estado=EJECUCION;
-    
-    /* Mostramos lista listos */
-    muestra_lista(&lista_listos);
-    /* Mostramos lista dormidos */
-    muestra_lista(&lista_dormidos);
-	fijar_nivel_int(nivel);
-    /* realizamos el cambio de contexto */
-    cambio_contexto(&(p_proc_anterior->contexto_regs), 
-            &(p_proc_actual->contexto_regs));
-    return /* no deberia llegar aqui */;
+    if (terminal_recibidos - terminal_leidos == TAM_TERMINAL){
+        LOG(LOG_AVISO, LOG_PROC, "-> TERMINAL LLENO: SE PIERDE ENTRADA\n");
+        return 0;
+    }
+    terminal[terminal_recibidos++ & (TAM_TERMINAL - 1)] = car;
+
+    /* en modo canonico se entrega la linea completa o la que llena el
+     * anillo, que si no nunca se podria leer */
+    if (modo_terminal == TERMINAL_CANONICO){
+        eco_terminal(&car, 1);
+        if (car != '\n' && terminal_recibidos - terminal_leidos < TAM_TERMINAL)
+            return 0;
+    }
+    terminal_disponibles = terminal_recibidos;
+    return 1;
 }
+
 /*
- * Funcion auxiliar que acutaliza los ticks de los procesos dormidos
- * cuando detecta que uno no tiene ticks pendientes lo envia a desbloquear
- *
+ * Funcion que vence el plazo de lectura en modo crudo de un proceso y lo
+ * pasa al lote de despertados del tick. Si ya lo habia despertado la
+ * llegada de caracteres no hace nada.
  */
+static void vencer_lectura(void *arg){
+    BCP *proc = arg;
 
-static void ajustar_dormidos(){
-	BCP *paux=lista_dormidos.primero;
-    BCP *paux_a_bloquear;
+    if (proc->estado != BLOQUEADO)
+        return;
+    eliminar_elem(&lista_terminal, proc);
+    insertar_ultimo(&lista_despertados, proc);
+}
 
-    while(paux){
-       // printk("Proceso id: %i, ticks remaining: %i\n", paux->id, paux->nticks);
-        paux->nticks--;
-        if(paux->nticks == 0){
-            printk("-> DESPERTANDO PROC: %d\n", paux->id);
-            // apuntamos al paux a bloquar 
-            paux_a_bloquear = paux;
-            //apuntamos al paux siguiente
-            paux = paux->siguiente;
-            //bloqueamos el paux a bloquar
-            desbloquear(paux_a_bloquear, &lista_dormidos);
-        }else{
-            paux = paux->siguiente;
-        }
-    }
-    return;
+/*
+ * Saca el siguiente caracter disponible del anillo, bloqueando al
+ * proceso actual mientras no lo haya. Se llama con interrupciones
+ * inhibidas.
+ */
+static char leer_terminal(){
+    while (terminal_leidos == terminal_disponibles)
+        bloquear(&lista_terminal);
+    return terminal[terminal_leidos++ & (TAM_TERMINAL - 1)];
 }
 
 ///* 
@@ -436,29 +2074,21 @@ static void ajustar_dormidos(){
 
 
 /*
- * funcion auxiliar que actualiza la prioridad
- * del proceso actual
+ * funcion auxiliar que cuenta un tick del proceso actual segun la
+ * politica de planificacion. Devuelve 1 si debe dejar la UCP.
  */
-static void ajustar_prioridad_actual(){
+static int ajustar_proceso_actual(){
+    int expulsa;
 
     /* Hay ocasiones que el proceso actual esta bloqueado y no hay ninguno listo */
-    if(p_proc_actual->estado != EJECUCION ) return;
-    //decrementamos la prio_efectiva del proceso actual
-    p_proc_actual->prioridad_efectiva -=1;
-    // si ha llegado a 0
-    if(p_proc_actual->prioridad_efectiva == 0){
-        printk("-> PROCESO %d AGOTA TIEMPO DE USO DE CPU\n",p_proc_actual->id);
-        /* ahora podemos comprobar si es necesario reajustar prioridades */
-        //  NO NECESARIO, se hace dentro de funcion maxima_prioridad() !
-        //if(comprobar_necesario_reajustar_prioridades())
-        //    reajustar_prioridades();
-        /* ahora replanificamos siempre que el planificador nos de un proceso diferente*/
-        if(p_proc_actual != planificador()){
-            replanificacion_pendiente = 1;
-            activar_int_SW();
-        }
-    }
-    return;
+    if(p_proc_actual->estado != EJECUCION ) return 0;
+    /* debe dejar la UCP si la clase o la politica lo indica y ya no es
+     * el mejor candidato */
+    expulsa = p_proc_actual->clase == CLASE_TR ? tr_tick() : planif->tick();
+    if (planif->reajustar)
+        planif->reajustar();
+    actualizar_mejor_listo();
+    return expulsa && p_proc_actual != mejor_listo;
 }
 
 /*
@@ -478,10 +2108,11 @@ static void ajustar_prioridad_actual(){
 static void exc_arit(){
 
 	if (!viene_de_modo_usuario())
-		panico("excepcion aritmetica cuando estaba dentro del kernel");
+		panico_nucleo("excepcion aritmetica cuando estaba dentro del kernel");
 
 
-	printk("-> EXCEPCION ARITMETICA EN PROC %d\n", p_proc_actual->id);
+	LOG(LOG_AVISO, LOG_PROC, "-> EXCEPCION ARITMETICA EN PROC %d\n", p_proc_actual->id);
+	TRAZA(EV_EXCEPCION, p_proc_actual->id, EXC_ARITM, 0);
 	liberar_proceso();
 
         return; /* no debera llegar aqui */
@@ -493,10 +2124,11 @@ static void exc_arit(){
 static void exc_mem(){
 
 	if (!viene_de_modo_usuario())
-		panico("excepcion de memoria cuando estaba dentro del kernel");
+		panico_nucleo("excepcion de memoria cuando estaba dentro del kernel");
 
 
-	printk("-> EXCEPCION DE MEMORIA EN PROC %d\n", p_proc_actual->id);
+	LOG(LOG_AVISO, LOG_PROC, "-> EXCEPCION DE MEMORIA EN PROC %d\n", p_proc_actual->id);
+	TRAZA(EV_EXCEPCION, p_proc_actual->id, EXC_MEM, 0);
 	liberar_proceso();
 
         return; /* no debera llegar aqui */
@@ -506,9 +2138,21 @@ static void exc_mem(){
  * Tratamiento de interrupciones de terminal
  */
 static void int_terminal(){
+	char car;
+
+	car = leer_puerto(DIR_TERMINAL);
+	TRAZA(EV_INT_TERMINAL, p_proc_actual ? p_proc_actual->id : -1, car, 0);
 
-	printk("-> TRATANDO INT. DE TERMINAL %c\n", leer_puerto(DIR_TERMINAL));
+	if (car == '\r')
+		car = '\n';	/* el terminal esta en modo crudo */
+	if (!recibir_caracter(car))
+		return;
 
+	/* los lectores pasan a listos ya, sin esperar al tick */
+	if (despertar_lista(&lista_terminal) && !replanificacion_pendiente){
+		replanificacion_pendiente = 1;
+		activar_int_SW();
+	}
         return;
 }
 
@@ -516,12 +2160,37 @@ static void int_terminal(){
  * Tratamiento de interrupciones de reloj
  */
 static void int_reloj(){
-
-	printk("-> TRATANDO INT. DE RELOJ\n");
+    int expulsa;
+
+	TRAZA(EV_INT_RELOJ, p_proc_actual->id, 0, 0);
+    ticks_sistema++;
+    pagina_datos.ticks = ticks_sistema;
+    /* contabilizamos el tick al proceso en ejecucion; si la UCP esta
+     * parada no es suyo aunque siga en EJECUCION, como un proceso de
+     * tiempo real que ha agotado su presupuesto */
+    if(en_espera_int)
+        ticks_ociosos++;
+    else if(p_proc_actual->estado == EJECUCION){
+        if(viene_de_modo_usuario())
+            p_proc_actual->uso.ticks_usuario++;
+        else
+            p_proc_actual->uso.ticks_nucleo++;
+    }
     // ajustamos prio del proceso actual
-    ajustar_prioridad_actual();
-    ajustar_dormidos();
-
+    expulsa = ajustar_proceso_actual();
+    /* procesos de tiempo real que empiezan periodo */
+    expulsa |= tr_reponer();
+    /* temporizadores que vencen en este tick y despertados en lote */
+    avanzar_rueda(ticks_sistema);
+    expulsa |= despertar_lista(&lista_despertados);
+
+    /* una sola interrupcion software por tick, que replanifica si hace
+     * falta y vuelca parte de la consola */
+    if(!replanificacion_pendiente &&
+            (expulsa || consola_pendiente())){
+        replanificacion_pendiente = expulsa;
+        activar_int_SW();
+    }
     return;
 }
 
@@ -536,10 +2205,12 @@ static void tratar_llamsis(){
 	nserv=leer_registro(0);
         // si el numero esta dentro del rango de
         // los registros definidos
+	TRAZA(EV_LLAMADA, p_proc_actual->id, nserv, 0);
 	if (nserv<NSERVICIOS)
 		res=(tabla_servicios[nserv].fservicio)();
 	else
 		res=-1;		/* servicio no existente */
+	TRAZA(EV_FIN_LLAMADA, p_proc_actual->id, nserv, res);
 	
     escribir_registro(0,res);
 	return;
@@ -550,7 +2221,10 @@ static void tratar_llamsis(){
  */
 static void int_sw(){
 
-	printk("-> TRATANDO INT. SW\n");
+	TRAZA(EV_INT_SW, p_proc_actual->id, 0, 0);
+    /* volcamos un trozo de la consola, que puede despertar a escritores */
+    if(consola_pendiente() && volcar_consola(DRENAJE_CONSOLA))
+        replanificacion_pendiente = 1;
     /* Si hay replanificacion pendiente */
     if(replanificacion_pendiente)
         replanificar();
@@ -576,7 +2250,7 @@ static int crear_tarea(char *prog){
 		return -1;	/* no hay entrada libre */
 
 	/* A rellenar el BCP ... */
-	p_proc=&(tabla_procs[proc]);
+	p_proc=tabla_procs[proc];
 
 	/* crea la imagen de memoria leyendo ejecutable */
 	imagen=crear_imagen(prog, &pc_inicial);
@@ -588,30 +2262,28 @@ static int crear_tarea(char *prog){
 			pc_inicial,
 			&(p_proc->contexto_regs));
 		p_proc->id=proc;
-        p_proc->nticks = 0; /* inicializamos los ticks a 0*/
-		p_proc->estado=LISTO;
+        series_procs[proc] = ++procesos_creados;
+        iniciar_temporizador(&p_proc->temp_dormir, despertar, p_proc);
+        iniciar_temporizador(&p_proc->temp_lectura, vencer_lectura, p_proc);
+        p_proc->nivel_listo = NO_ENCOLADO;
+        p_proc->pos_monticulo = NO_ENCOLADO;
+        p_proc->color = FUERA_ARBOL;
+        p_proc->epoca = epoca_prioridades;
+        p_proc->clase = CLASE_NORMAL; /* el tiempo real no se hereda */
+        p_proc->fallos_plazo = 0;
+        memset(&p_proc->uso, 0, sizeof(p_proc->uso));
+        memset(&p_proc->uso_hijos, 0, sizeof(p_proc->uso_hijos));
+        p_proc->us_despertar = 0;
+        p_proc->primer_hijo = NULL;
+		pasar_a_listo(p_proc);
         /* si hay proceso actual es el padre del nuevo */
         if (p_proc_actual){
             // incluimos la id del padre
             p_proc->id_padre = p_proc_actual->id;
-            // la prioridad base se mantiene
+            anadir_hijo(p_proc_actual, p_proc);
+            // la prioridad base y la efectiva se heredan del padre
             p_proc->prioridad = p_proc_actual->prioridad;
-            /* comprobamos las condiciones para repartir la prio_efectiva */
-            if(!(p_proc_actual->prioridad == MIN_PRIO &&
-                    p_proc_actual->prioridad_efectiva <= MIN_PRIO)){
-                /* dividimos la prioridad del padre
-                 * por que se repartira con el hijo 
-                 */
-                p_proc_actual->prioridad_efectiva /=  2;
-            }
-            // asignamos la prioridad efectiva al hijo
             p_proc->prioridad_efectiva = p_proc_actual->prioridad_efectiva;
-
-            /*  comprobamos que el padre sigue siendo el mas prioritario */
-            if(p_proc_actual != planificador()){
-                replanificacion_pendiente = 1;
-                activar_int_SW();
-            }
         }else{
             //incluimod la id de huerfano
             p_proc->id_padre = ID_HUERFANO;
@@ -624,17 +2296,31 @@ static int crear_tarea(char *prog){
 
         /* detenemos interrupciones */
         nivel=fijar_nivel_int(NIVEL_3); /*nivel 3 detiene todas */
+
+        /* la politica reparte lo que corresponda entre padre e hijo */
+        planif->repartir((p_proc_actual && p_proc_actual->clase == CLASE_NORMAL) ?
+                p_proc_actual : NULL, p_proc);
 		
         /* lo inserta al final de cola de listos */
 		insertar_ultimo(&lista_listos, p_proc);
+        num_procesos++;
+        TRAZA(EV_CREAR, p_proc->id, p_proc->id_padre, 0);
+
+        /*  comprobamos que el padre sigue siendo el mas prioritario */
+        if(p_proc_actual && p_proc_actual != mejor_listo){
+            replanificacion_pendiente = 1;
+            activar_int_SW();
+        }
         
         /*  volvemos a poner interrupciones como antes */
         fijar_nivel_int(nivel);
 		
         error= 0;
 	}
-	else
+	else{
+		liberar_BCP(p_proc);
 		error= -1; /* fallo al crear imagen */
+	}
 
 	return error;
 }
@@ -654,7 +2340,7 @@ int sis_crear_proceso(){
 	char *prog;
 	int res;
 
-	printk("-> PROC %d: CREAR PROCESO\n", p_proc_actual->id);
+	LOG(LOG_INFO, LOG_LLAMSIS, "-> PROC %d: CREAR PROCESO\n", p_proc_actual->id);
 	prog=(char *)leer_registro(1);
 	res=crear_tarea(prog);
 	return res;
@@ -665,7 +2351,6 @@ int sis_crear_proceso(){
  * proceso actual
  */
 int sis_get_pid(){
-    printk("-> A DINS DE SIS_GET_PID\n");
     return p_proc_actual->id;
 
 }
@@ -675,11 +2360,27 @@ int sis_get_pid(){
  * padre del proceso actual
  */
 int sis_get_ppid(){
-    printk("-> A DINS DE SIS_GET_PPID\n");
     return p_proc_actual->id_padre;
 
 }
 
+/*
+ * Funcion auxiliar que duerme al proceso actual hasta el tick absoluto
+ * expiracion. Si ya ha pasado vuelve sin bloquearse.
+ */
+static void dormir_hasta_tick(unsigned long expiracion){
+    int nivel;
+
+    /* armamos su temporizador y lo ponemos a dormir sin que pueda
+     * vencer antes de estar bloqueado */
+    nivel=fijar_nivel_int(NIVEL_3);
+    if (expiracion > ticks_sistema){
+        armar_temporizador(&p_proc_actual->temp_dormir, expiracion);
+        bloquear(&lista_dormidos);
+    }
+    fijar_nivel_int(nivel);
+}
+
 /*
  * Tratamiento de llamada al sistema dormir. Pone el proceso actual 
  * a dormir y pasa al siguiente proceso
@@ -688,39 +2389,88 @@ int sis_dormir(){
 
     unsigned int segundos;
     segundos=(unsigned int)leer_registro(1);
-    printk("-> PROC %d A DORMIR %d SEGUNDOS\n",p_proc_actual->id, segundos);
+    LOG(LOG_INFO, LOG_LLAMSIS, "-> PROC %d A DORMIR %d SEGUNDOS\n",p_proc_actual->id, segundos);
     
-    /* insertamos el numero de ticks */
-    p_proc_actual->nticks = segundos * TICK;
-    
-    /* solicitamos poner el proceso a dormir */
-    bloquear(&lista_dormidos);
+    dormir_hasta_tick(ticks_sistema + segundos * TICK);
+    return 0;
+}
+
+/*
+ * Tratamiento de llamada al sistema dormir_ms. Duerme al proceso actual
+ * al menos los milisegundos indicados, redondeando a ticks por arriba
+ */
+int sis_dormir_ms(){
+    unsigned int milisegundos;
+    unsigned long ticks;
+
+    milisegundos=(unsigned int)leer_registro(1);
+    LOG(LOG_INFO, LOG_LLAMSIS, "-> PROC %d A DORMIR %d MS\n",p_proc_actual->id, milisegundos);
+
+    ticks = ((unsigned long)milisegundos * TICK + 999) / 1000;
+    dormir_hasta_tick(ticks_sistema + ticks);
     return 0;
 }
 
 /*
- * Tratamiento de llamada al sistema escribir. Llama simplemente a la
- * funcion de apoyo escribir_ker
+ * Tratamiento de llamada al sistema dormir_hasta. Duerme al proceso
+ * actual hasta el tick absoluto indicado, lo que permite a los procesos
+ * periodicos no acumular retraso. Devuelve el tick al despertar.
+ */
+int sis_dormir_hasta(){
+    unsigned long tick;
+
+    tick=(unsigned long)leer_registro(1);
+    LOG(LOG_INFO, LOG_LLAMSIS, "-> PROC %d A DORMIR HASTA EL TICK %lu\n",p_proc_actual->id, tick);
+
+    dormir_hasta_tick(tick);
+    return (int)ticks_sistema;
+}
+
+/*
+ * Tratamiento de llamada al sistema escribir. Copia el texto en el
+ * anillo de la consola, que se vuelca despues; si no cabe bloquea al
+ * proceso hasta que se haya volcado lo suficiente
  */
 int sis_escribir()
 {
 	char *texto;
 	unsigned int longi;
+	unsigned long libre;
+	int nivel;
 
 	texto=(char *)leer_registro(1);
 	longi=(unsigned int)leer_registro(2);
 
-	escribir_ker(texto, longi);
+	nivel=fijar_nivel_int(NIVEL_3);
+	while (longi > 0){
+		libre = TAM_CONSOLA - (consola_escritos - consola_volcados);
+		if (libre == 0){
+			bloquear(&lista_consola);
+			continue;
+		}
+		for (; libre > 0 && longi > 0; libre--, longi--)
+			consola[consola_escritos++ & (TAM_CONSOLA - 1)] = *texto++;
+	}
+	fijar_nivel_int(nivel);
 	return 0;
 }
 
+/*
+ * Comprueba si escribir cabe entero en el anillo de la consola y, por
+ * tanto, no bloquearia. Lo usa lote para hacerla sin salir del lote.
+ */
+int escribir_sin_bloqueo(long *args){
+	return (unsigned long)(unsigned int)args[1] <=
+		TAM_CONSOLA - (consola_escritos - consola_volcados);
+}
+
 /*
  * Tratamiento de llamada al sistema terminar_proceso. Llama a la
  * funcion auxiliar liberar_proceso
  */
 int sis_terminar_proceso(){
 
-	printk("-> FIN PROCESO %d\n", p_proc_actual->id);
+	LOG(LOG_INFO, LOG_LLAMSIS, "-> FIN PROCESO %d\n", p_proc_actual->id);
 
 	liberar_proceso();
 
@@ -733,7 +2483,7 @@ int sis_terminar_proceso(){
  */
 int sis_fijar_prio(){
     unsigned int prioridad, prioridad_anterior;
-    int prioridad_efectiva_anterior;
+    int nivel;
 
     /* Obtenemos la prioridad a aplicar */
     prioridad=(unsigned int)leer_registro(1);
@@ -742,52 +2492,359 @@ int sis_fijar_prio(){
     if (prioridad < MIN_PRIO) return -1;
     if (prioridad > MAX_PRIO) return -1;
     
-    printk("-> PROC %d, FIJANDO PRIORIDAD DE %d A %d\n",p_proc_actual->id, p_proc_actual->prioridad, prioridad);
+    LOG(LOG_INFO, LOG_LLAMSIS, "-> PROC %d, FIJANDO PRIORIDAD DE %d A %d\n",p_proc_actual->id, p_proc_actual->prioridad, prioridad);
     
-    /* nos guardamos la prioridad actual (base y efectiva) como la anterior */
+    /* nos guardamos la prioridad base actual como la anterior */
     prioridad_anterior = p_proc_actual->prioridad;
-    prioridad_efectiva_anterior = p_proc_actual->prioridad_efectiva;
 
     p_proc_actual->prioridad = prioridad; /*  asignamos la prioridad base */
-    /* comprobamos las condiciones para asignar una prio_efectiva u otra */
-    if(prioridad >= prioridad_anterior){
-        /* la prio_e = prio_e_ant * (prio + prio_ant) /(2 prio_ant)*/
-        p_proc_actual->prioridad_efectiva *= ( (prioridad + prioridad_anterior)/(prioridad_anterior * 2) );
-    }else{
-        /* La prio_e = prio_e_ant * (prio / prio_ant) evitando problemas con enteros*/
-        p_proc_actual->prioridad_efectiva *= (prioridad / (prioridad_anterior ));
-    }
-    
-    printk("-> PROC %d, FIJANDO PRIORIDAD_E DE %d A %d\n",p_proc_actual->id,
-            prioridad_efectiva_anterior, p_proc_actual->prioridad_efectiva);
+    pagina_datos.prioridad = prioridad;
+
+    /* la politica ajusta su estado a la nueva prioridad */
+    nivel=fijar_nivel_int(NIVEL_3);
+    if (p_proc_actual->clase == CLASE_NORMAL)
+        planif->cambio_prio(p_proc_actual, prioridad_anterior);
+    actualizar_mejor_listo();
+    fijar_nivel_int(nivel);
+    TRAZA(EV_PRIORIDAD, p_proc_actual->id, p_proc_actual->prioridad,
+            p_proc_actual->prioridad_efectiva);
     
     /* Mostramos lista listos */
     muestra_lista(&lista_listos);
     /* Mostramos lista dormidos */
     muestra_lista(&lista_dormidos);
 
-    /* comprobamos si se cumplen las condiciones para replanificar */
-    if(p_proc_actual->prioridad_efectiva < prioridad_efectiva_anterior){
-        /* comprobamos que no sigue siendo el mismo con la max prio */
-        if(p_proc_actual != maxima_prioridad(&lista_listos)){
-            /* si la prioridad_anterior es mayor, hay que replanificar */
-            if(!replanificacion_pendiente){ /* comprobamos que no haya ya una replanificacino pendiente */
-                replanificacion_pendiente = 1;
-                activar_int_SW();
-            }
+    /* comprobamos que no sigue siendo el mismo con la max prio */
+    if(p_proc_actual != mejor_listo){
+        if(!replanificacion_pendiente){ /* comprobamos que no haya ya una replanificacino pendiente */
+            replanificacion_pendiente = 1;
+            activar_int_SW();
+        }
+    }
+    return 0;
+}
+
+/*
+ * Tratamiento de llamada al sistema fijar_tiempo_real. Pasa el proceso
+ * actual a la clase de tiempo real con el periodo, presupuesto y plazo
+ * relativo dados en ticks, o lo devuelve a la clase normal si el periodo
+ * es 0. Se rechaza si la densidad total superaria UTIL_MAX_TR.
+ */
+int sis_fijar_tiempo_real(){
+    unsigned int periodo, presupuesto, plazo;
+    int densidad = 0, anterior = 0;
+    int nivel;
+
+    periodo=(unsigned int)leer_registro(1);
+    presupuesto=(unsigned int)leer_registro(2);
+    plazo=(unsigned int)leer_registro(3);
+
+    LOG(LOG_INFO, LOG_LLAMSIS, "-> PROC %d, TIEMPO REAL: PERIODO %d PRESUPUESTO %d PLAZO %d\n",
+            p_proc_actual->id, periodo, presupuesto, plazo);
+
+    /* comprobamos que sean parametros validos */
+    if (periodo != 0){
+        if (presupuesto == 0 || presupuesto > plazo || plazo > periodo)
+            return -1;
+        densidad = (presupuesto * UTIL_ESCALA) / plazo;
+    }
+
+    nivel=fijar_nivel_int(NIVEL_3);
+
+    /* control de admision descontando su reserva anterior */
+    if (p_proc_actual->clase == CLASE_TR)
+        anterior = p_proc_actual->densidad;
+    if (utilizacion_tr - anterior + densidad > UTIL_MAX_TR){
+        fijar_nivel_int(nivel);
+        LOG(LOG_AVISO, LOG_LLAMSIS, "-> PROC %d, TIEMPO REAL RECHAZADO\n", p_proc_actual->id);
+        return -1;
+    }
+    utilizacion_tr += densidad - anterior;
+
+    /* sale de su clase y entra en la nueva */
+    eliminar_elem(&lista_listos, p_proc_actual);
+    if (periodo != 0){
+        p_proc_actual->clase = CLASE_TR;
+        p_proc_actual->periodo = periodo;
+        p_proc_actual->presupuesto = presupuesto;
+        p_proc_actual->plazo = plazo;
+        p_proc_actual->densidad = densidad;
+        tr_nuevo_trabajo(p_proc_actual, ticks_sistema);
+    }
+    else
+        p_proc_actual->clase = CLASE_NORMAL;
+    insertar_ultimo(&lista_listos, p_proc_actual);
+    fijar_nivel_int(nivel);
+
+    /* comprobamos que sigue siendo el que debe ejecutar */
+    if(p_proc_actual != mejor_listo){
+        if(!replanificacion_pendiente){
+            replanificacion_pendiente = 1;
+            activar_int_SW();
+        }
+    }
+    return 0;
+}
+
+/*
+ * Tratamiento de llamada al sistema fallos_plazo. Devuelve los plazos
+ * perdidos por el proceso pid o -1 si no existe
+ */
+int sis_fallos_plazo(){
+    int pid;
+
+    pid=(int)leer_registro(1);
+    if (pid < 0 || pid >= capacidad_procs) return -1;
+    if (tabla_procs[pid]->estado == NO_USADA) return -1;
+    return tabla_procs[pid]->fallos_plazo;
+}
+
+/*
+ * Tratamiento de llamada al sistema leer_uso. Copia en la estructura del
+ * llamante el uso de UCP y de planificacion del proceso actual y el
+ * acumulado de sus hijos terminados
+ */
+int sis_leer_uso(){
+    uso_proceso *uso;
+    int nivel;
+
+    uso=(uso_proceso *)leer_registro(1);
+    if (uso == NULL) return -1;
+
+    nivel=fijar_nivel_int(NIVEL_3);
+    uso->propio = p_proc_actual->uso;
+    uso->hijos = p_proc_actual->uso_hijos;
+    fijar_nivel_int(nivel);
+    return 0;
+}
+
+/*
+ * Tratamiento de llamada al sistema leer_latencias. Copia en la
+ * estructura del llamante el histograma de latencias de despertar de
+ * la prioridad base indicada o el global si es LATENCIA_GLOBAL
+ */
+int sis_leer_latencias(){
+    unsigned int prioridad;
+    histograma_latencia *h;
+    int nivel;
+
+    prioridad=(unsigned int)leer_registro(1);
+    h=(histograma_latencia *)leer_registro(2);
+    if (h == NULL) return -1;
+    if (prioridad != LATENCIA_GLOBAL &&
+            (prioridad < MIN_PRIO || prioridad > MAX_PRIO))
+        return -1;
+
+    nivel=fijar_nivel_int(NIVEL_3);
+    if (prioridad == LATENCIA_GLOBAL)
+        *h = latencia_global;
+    else
+        *h = latencia_prio[prioridad - MIN_PRIO];
+    fijar_nivel_int(nivel);
+    return 0;
+}
+
+/*
+ * Tratamiento de llamada al sistema volcar_traza. Vuelca los eventos de
+ * la traza anotados desde el ultimo volcado
+ */
+int sis_volcar_traza(){
+    if (!traza_activa) return -1;
+    volcar_traza();
+    return 0;
+}
+
+/*
+ * Tratamiento de llamada al sistema leer_reloj. Copia en la estructura
+ * del llamante los ticks y los us transcurridos desde el arranque; no
+ * escribe mensajes ni inhibe interrupciones para que se pueda usar en
+ * bucles de medida
+ */
+int sis_leer_reloj(){
+    reloj_monotono *reloj;
+
+    reloj=(reloj_monotono *)leer_registro(1);
+    if (reloj == NULL) return -1;
+
+    reloj->ticks = ticks_sistema;
+    reloj->us = reloj_us() - us_arranque;
+    return 0;
+}
+
+/*
+ * Tratamiento de llamada al sistema pagina_datos_nucleo. Devuelve en el puntero
+ * del llamante la direccion de la pagina de datos del nucleo, que la
+ * biblioteca consulta despues sin llamadas al sistema
+ */
+int sis_pagina_datos_nucleo(){
+    const datos_nucleo **pagina;
+
+    pagina=(const datos_nucleo **)leer_registro(1);
+    if (pagina == NULL) return -1;
+
+    *pagina = &pagina_datos;
+    return 0;
+}
+
+/*
+ * Tratamiento de llamada al sistema leer_caracter. Devuelve el siguiente
+ * caracter del terminal, bloqueando al proceso hasta que llegue
+ */
+int sis_leer_caracter(){
+    int nivel, car;
+
+    nivel=fijar_nivel_int(NIVEL_3);
+    car = (unsigned char)leer_terminal();
+    fijar_nivel_int(nivel);
+    return car;
+}
+
+/*
+ * Tratamiento de llamada al sistema leer_linea. Copia en el buffer del
+ * llamante los caracteres del terminal hasta el fin de linea incluido o
+ * hasta llenarlo, terminados en nulo, bloqueando mientras falten.
+ * Devuelve cuantos ha copiado.
+ */
+int sis_leer_linea(){
+    char *buf;
+    int max, n, nivel;
+
+    buf=(char *)leer_registro(1);
+    max=(int)leer_registro(2);
+    if (buf == NULL || max <= 0) return -1;
+
+    nivel=fijar_nivel_int(NIVEL_3);
+    for (n=0; n < max - 1; )
+        if ((buf[n++] = leer_terminal()) == '\n')
+            break;
+    buf[n] = '\0';
+    fijar_nivel_int(nivel);
+    return n;
+}
+
+/*
+ * Tratamiento de llamada al sistema leer. Copia en el buffer del
+ * llamante hasta n caracteres del terminal de una vez y devuelve
+ * cuantos. En modo canonico espera a que haya una linea completa y no
+ * pasa de su fin; en modo crudo espera a que haya terminal_min (o uno
+ * si solo hay plazo) o a que venza el plazo, y si ambos son 0 no espera.
+ */
+int sis_leer(){
+    char *buf;
+    int n, copiados = 0, nivel;
+    unsigned long minimo, limite = 0;
+
+    buf=(char *)leer_registro(1);
+    n=(int)leer_registro(2);
+    if (buf == NULL || n < 0) return -1;
+
+    nivel=fijar_nivel_int(NIVEL_3);
+    if (modo_terminal == TERMINAL_CANONICO){
+        while (terminal_leidos == terminal_disponibles)
+            bloquear(&lista_terminal);
+    }
+    else {
+        minimo = terminal_min ? terminal_min : (terminal_plazo ? 1 : 0);
+        if (minimo > (unsigned long)n)
+            minimo = n;
+        if (terminal_plazo){
+            limite = ticks_sistema + terminal_plazo;
+            armar_temporizador(&p_proc_actual->temp_lectura, limite);
+        }
+        while (terminal_disponibles - terminal_leidos < minimo &&
+                !(limite && ticks_sistema >= limite))
+            bloquear(&lista_terminal);
+        cancelar_temporizador(&p_proc_actual->temp_lectura);
+    }
+
+    while (copiados < n && terminal_leidos < terminal_disponibles){
+        buf[copiados] = terminal[terminal_leidos++ & (TAM_TERMINAL - 1)];
+        if (buf[copiados++] == '\n' && modo_terminal == TERMINAL_CANONICO)
+            break;
+    }
+    fijar_nivel_int(nivel);
+    return copiados;
+}
+
+/*
+ * Tratamiento de llamada al sistema fijar_modo_terminal. Elige modo
+ * canonico o crudo y, para este, el minimo de caracteres y el plazo en
+ * milisegundos de leer. Al pasar a crudo la linea en edicion se puede
+ * leer ya.
+ */
+int sis_fijar_modo_terminal(){
+    int modo, nivel;
+    unsigned int min, milisegundos;
+
+    modo=(int)leer_registro(1);
+    min=(unsigned int)leer_registro(2);
+    milisegundos=(unsigned int)leer_registro(3);
+    if (modo != TERMINAL_CANONICO && modo != TERMINAL_CRUDO) return -1;
+    if (min > TAM_TERMINAL) return -1;
+
+    LOG(LOG_INFO, LOG_LLAMSIS, "-> PROC %d: MODO DE TERMINAL %d\n", p_proc_actual->id, modo);
+    nivel=fijar_nivel_int(NIVEL_3);
+    modo_terminal = modo;
+    terminal_min = min;
+    terminal_plazo = ((unsigned long)milisegundos * TICK + 999) / 1000;
+    if (modo == TERMINAL_CRUDO && terminal_disponibles != terminal_recibidos){
+        terminal_disponibles = terminal_recibidos;
+        if (despertar_lista(&lista_terminal)){
+            replanificacion_pendiente = 1;
+            activar_int_SW();
         }
     }
+    fijar_nivel_int(nivel);
     return 0;
 }
 
+/*
+ * Tratamiento de llamada al sistema lote. Ejecuta en una sola entrada
+ * al nucleo las peticiones del vector del llamante, dejando en cada una
+ * su resultado. Se para antes de la primera que pueda bloquear o
+ * terminar al proceso, que el llamante debe hacer aparte, y devuelve
+ * cuantas se han hecho. Las que solo bloquean a veces, como escribir
+ * cuando la consola esta llena, se hacen si en ese momento no lo harian.
+ */
+int sis_lote(){
+    peticion_lote *lote;
+    int num, i, j;
+
+    lote=(peticion_lote *)leer_registro(1);
+    num=(int)leer_registro(2);
+    if (lote == NULL || num < 0) return -1;
+
+    LOG(LOG_INFO, LOG_LLAMSIS, "-> PROC %d: LOTE DE %d LLAMADAS\n", p_proc_actual->id, num);
+    for (i=0; i<num; i++){
+        if (lote[i].servicio < 0 || lote[i].servicio >= NSERVICIOS){
+            lote[i].resultado = -1;	/* servicio no existente */
+            continue;
+        }
+        if (tabla_servicios[lote[i].servicio].bloquea &&
+                !(tabla_servicios[lote[i].servicio].sin_bloqueo &&
+                  tabla_servicios[lote[i].servicio].sin_bloqueo(lote[i].args)))
+            break;
+
+        /* cada servicio lee sus argumentos de los registros */
+        for (j=0; j<ARGS_LOTE; j++)
+            escribir_registro(j+1, lote[i].args[j]);
+        lote[i].resultado = (tabla_servicios[lote[i].servicio].fservicio)();
+    }
+    return i;
+}
+
 /*
  *
  * Rutina de inicializacin invocada en arranque
  *
  */
 int main(){
+	char *inicial;
+
 	/* se llega con las interrupciones prohibidas */
+	iniciar_traza();
 	iniciar_tabla_proc();
+	iniciar_planificacion();
 
 	instal_man_int(EXC_ARITM, exc_arit); 
 	instal_man_int(EXC_MEM, exc_mem); 
@@ -800,16 +2857,19 @@ int main(){
 	iniciar_cont_reloj(TICK);	/* fija frecuencia del reloj */
 	iniciar_cont_teclado();		/* inici cont. teclado */
 
-	/* crea proceso inicial */
-	if (crear_tarea((void *)"init")<0)
-		panico("no encontrado el proceso inicial");
+	/* crea proceso inicial, init o el indicado en MINIKERNEL_INIT */
+	inicial=getenv("MINIKERNEL_INIT");
+	if (inicial==NULL)
+		inicial="init";
+	if (crear_tarea(inicial)<0)
+		panico_nucleo("no encontrado el proceso inicial");
 	
 	/* activa proceso inicial */
 	p_proc_actual=planificador();
-    p_proc_actual->estado = EJECUCION;
+    pasar_a_ejecucion(p_proc_actual);
 
     /* proceso que dejo de ejecutar, y proceso que paso a ejecutar*/
 	cambio_contexto(NULL, &(p_proc_actual->contexto_regs));
-	panico("S.O. reactivado inesperadamente");
+	panico_nucleo("S.O. reactivado inesperadamente");
 	return 0;
 }
@@ -0,0 +1,41 @@
+/*
+ * usuario/eco.c
+ *
+ */
+
+/*
+ * Programa de usuario que repite cada linea que se teclea hasta recibir
+ * "fin", mostrando cuanto ha tardado en atenderla y cuanta UCP ha gastado
+ * esperando
+ */
+
+#include "servicios.h"
+
+#define TAM_LINEA 80
+
+static int iguales(char *a, char *b){
+    while (*a && *a == *b){
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+int main(){
+    char linea[TAM_LINEA];
+    uso_proceso uso;
+    int n;
+
+    printf("eco: escriba lineas, \"fin\" para terminar\n");
+    while ((n = leer_linea(linea, TAM_LINEA)) > 0){
+        if (linea[n - 1] == '\n')
+            linea[--n] = '\0';
+        if (iguales(linea, "fin"))
+            break;
+        leer_uso(&uso);
+        printf("eco: \"%s\" (%d caracteres, %d ticks de UCP)\n", linea, n,
+            uso.propio.ticks_usuario + uso.propio.ticks_nucleo);
+    }
+    printf("eco: termina\n");
+    return 0;
+}
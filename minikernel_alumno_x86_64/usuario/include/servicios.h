@@ -19,11 +19,77 @@
 #ifndef SERVICIOS_H
 #define SERVICIOS_H
 
+/* Modos de lectura del terminal (ver leer y fijar_modo_terminal) */
+#define TERMINAL_CANONICO 0	/* lineas completas, con edicion y eco */
+#define TERMINAL_CRUDO 1	/* cada caracter segun llega */
+
+/* Salida con buffer (ver imprimirf y fijar_modo_salida) */
+#define TAM_SALIDA 1024
+#define SALIDA_LINEA 0		/* vuelca en cada fin de linea, por defecto */
+#define SALIDA_SIN_BUFFER 1
+#define SALIDA_COMPLETA 2	/* vuelca al llenarse */
+
 /* Evita el uso del printf de la bilioteca estndar */
-#define printf escribirf
+#define printf imprimirf
+
+/* Uso de UCP y de planificacion de un proceso (ver leer_uso) */
+typedef struct{
+	unsigned int ticks_usuario;	/* ticks ejecutando en modo usuario */
+	unsigned int ticks_nucleo;	/* ticks ejecutando en modo sistema */
+	unsigned int ticks_espera;	/* ticks listo sin ejecutar */
+	unsigned int cambios_voluntarios; /* veces que se ha bloqueado */
+	unsigned int cambios_involuntarios; /* veces que ha sido expulsado */
+} contadores_uso;
+
+typedef struct{
+	contadores_uso propio;
+	contadores_uso hijos;		/* de sus hijos ya terminados */
+} uso_proceso;
+
+/* Histograma de latencias de despertar en cubetas log2 de us (ver
+ * leer_latencias); la cubeta b cuenta de 2^(b-1) a 2^b - 1 us */
+#define NUM_CUBETAS_LATENCIA 32
+#define LATENCIA_GLOBAL 0
+
+typedef struct{
+	unsigned int cubetas[NUM_CUBETAS_LATENCIA];
+	unsigned int num;		/* latencias medidas */
+	unsigned int maximo;		/* mayor latencia en us */
+} histograma_latencia;
 
-/* Funcion de biblioteca */
+/* Reloj monotono desde el arranque (ver leer_reloj) */
+typedef struct{
+	unsigned long ticks;		/* ticks de reloj desde el arranque */
+	unsigned long us;		/* us desde el arranque segun el anfitrion */
+} reloj_monotono;
+
+/* Pagina de datos del nucleo del proceso en ejecucion, que la biblioteca
+ * lee sin llamadas al sistema (ver pagina_datos_nucleo) */
+typedef struct{
+	int pid;
+	int ppid;
+	unsigned int prioridad;		/* prioridad base */
+	unsigned long ticks;		/* ticks de reloj desde el arranque */
+	const unsigned long *series;	/* n. de creacion de cada pid vivo,
+					   unico por proceso, 0 si libre */
+} datos_nucleo;
+
+/* Peticion de un lote de llamadas (ver lote_llamadas y ejecutar_lote);
+ * los numeros de llamada estan en llamsis.h */
+#define ARGS_LOTE 5
+
+typedef struct{
+	int servicio;			/* numero de llamada */
+	int resultado;			/* lo rellena el nucleo */
+	long args[ARGS_LOTE];
+} peticion_lote;
+
+/* Funciones de biblioteca; escribirf escribe sin buffer */
 int escribirf(const char *formato, ...);
+int imprimirf(const char *formato, ...);
+int fijar_modo_salida(int modo);
+int vaciar_salida();
+void terminar_salida();
 
 /* Llamadas al sistema proporcionadas */
 int crear_proceso(char *prog);
@@ -33,5 +99,30 @@ int get_pid();
 int dormir(unsigned int segundos);
 int fijar_prio(unsigned int prio);
 int get_ppid();
+int fijar_tiempo_real(unsigned int periodo, unsigned int presupuesto,
+		unsigned int plazo);
+int fallos_plazo(int pid);
+int dormir_ms(unsigned int milisegundos);
+int dormir_hasta(unsigned long tick);
+int leer_uso(uso_proceso *uso);
+int leer_latencias(unsigned int prioridad, histograma_latencia *h);
+int volcar_traza();
+int leer_reloj(reloj_monotono *reloj);
+int pagina_datos_nucleo(const datos_nucleo **pagina);
+int lote_llamadas(peticion_lote *lote, int num);
+int leer_caracter();
+int leer_linea(char *buf, int max);
+int leer(char *buf, int n);
+int fijar_modo_terminal(int modo, unsigned int min,
+		unsigned int milisegundos);
+
+/* Consultas que leen la pagina de datos del nucleo sin llamada */
+unsigned long leer_ticks();
+int leer_prio();
+unsigned long leer_serie(int pid);
+
+/* Apoyo a los lotes de llamadas */
+void preparar_peticion(peticion_lote *p, int servicio, int nargs, ...);
+int ejecutar_lote(peticion_lote *lote, int num);
 #endif /* SERVICIOS_H */
 
@@ -13,8 +13,23 @@
 */
 
 #include "servicios.h"
+#include "llamsis.h"
+
+/* programas que se crean al arrancar */
+static char *programas[]={
+    "simplon", "simplon", "simplon", "simplon", "simplon",
+    "simplon", "simplon", "simplon", "simplon",
+    /* Este programa crea otro proceso que ejecuta simplon a
+       una excepcin */
+    "excep_mem",
+    /* No existe: debe fallar */
+    "noexiste"};
+
+#define NUM_PROGRAMAS (sizeof(programas)/sizeof(programas[0]))
 
 int main(){
+    peticion_lote lote[NUM_PROGRAMAS];
+    int i;
 
 	printf("init: comienza\n");
 /*
@@ -34,32 +49,13 @@ int main(){
 //	if (crear_proceso("dormilon")<0)
 //                printf("Error creando dormilon\n");
 
-    if (crear_proceso("simplon")<0)
-                printf("Error creando simplon\n");
-    if (crear_proceso("simplon")<0)
-                printf("Error creando simplon\n");
-    if (crear_proceso("simplon")<0)
-                printf("Error creando simplon\n");
-    if (crear_proceso("simplon")<0)
-                printf("Error creando simplon\n");
-    if (crear_proceso("simplon")<0)
-                printf("Error creando simplon\n");
-    if (crear_proceso("simplon")<0)
-                printf("Error creando simplon\n");
-    if (crear_proceso("simplon")<0)
-                printf("Error creando simplon\n");
-    if (crear_proceso("simplon")<0)
-                printf("Error creando simplon\n");
-    if (crear_proceso("simplon")<0)
-                printf("Error creando simplon\n");
-	/* Este programa crea otro proceso que ejecuta simplon a
-	   una excepcin */
-	if (crear_proceso("excep_mem")<0)
-		printf("Error creando excep_mem\n");
-	
-	/* No existe: debe fallar */
-	if (crear_proceso("noexiste")<0)
-		printf("Error creando noexiste\n");
+    /* crea los programas en un solo lote de llamadas */
+    for (i=0; i<NUM_PROGRAMAS; i++)
+        preparar_peticion(&lote[i], CREAR_PROCESO, 1, (long)programas[i]);
+    ejecutar_lote(lote, NUM_PROGRAMAS);
+    for (i=0; i<NUM_PROGRAMAS; i++)
+        if (lote[i].resultado<0)
+            printf("Error creando %s\n", programas[i]);
 
     printf("init: termina\n");
 	return 0; 
@@ -0,0 +1,60 @@
+/*
+ * usuario/latencias.c
+ *
+ */
+
+/*
+ * Programa de usuario que muestra los percentiles de latencia desde que
+ * un proceso despierta hasta que ejecuta, en global y por cada prioridad
+ * base con medidas. Cada valor es el limite superior de su cubeta log2,
+ * sin pasar de la mayor latencia medida.
+ */
+
+#include "servicios.h"
+#include "const.h"	/* MIN_PRIO MAX_PRIO */
+
+/* limite superior en us de la cubeta b */
+static unsigned int limite_cubeta(int b){
+    return b ? (1U << b) - 1 : 0;
+}
+
+/* menor limite de cubeta que cubre el tanto por cien pct de medidas */
+static unsigned int percentil(histograma_latencia *h, int pct){
+    unsigned int objetivo, acumulado = 0;
+    int b;
+
+    objetivo = (h->num * pct + 99) / 100;
+    for (b = 0; b < NUM_CUBETAS_LATENCIA; b++){
+        acumulado += h->cubetas[b];
+        if (acumulado >= objetivo)
+            break;
+    }
+    /* la cubeta puede pasarse de la mayor medida */
+    if (b == NUM_CUBETAS_LATENCIA || limite_cubeta(b) > h->maximo)
+        return h->maximo;
+    return limite_cubeta(b);
+}
+
+static void mostrar(int prio, histograma_latencia *h){
+    if (prio == LATENCIA_GLOBAL)
+        printf("global: ");
+    else
+        printf("prio %d: ", prio);
+    printf("n %d p50 %d p90 %d p99 %d max %d us\n", h->num,
+        percentil(h, 50), percentil(h, 90), percentil(h, 99), h->maximo);
+}
+
+int main(){
+    histograma_latencia h;
+    int prio;
+
+    if (leer_latencias(LATENCIA_GLOBAL, &h) < 0){
+        printf("latencias: error\n");
+        return 0;
+    }
+    mostrar(LATENCIA_GLOBAL, &h);
+    for (prio = MIN_PRIO; prio <= MAX_PRIO; prio++)
+        if (leer_latencias(prio, &h) == 0 && h.num > 0)
+            mostrar(prio, &h);
+    return 0;
+}
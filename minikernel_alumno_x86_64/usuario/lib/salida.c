@@ -0,0 +1,161 @@
+/*
+ *  usuario/lib/salida.c
+ *
+ */
+
+/*
+ *
+ * Salida con buffer para printf (imprimirf). Cada proceso tiene su
+ * buffer, que se vuelca con una sola llamada escribir segun el modo:
+ *
+ *	SALIDA_LINEA		al completar una linea (por defecto)
+ *	SALIDA_SIN_BUFFER	en cada imprimirf
+ *	SALIDA_COMPLETA		cuando se llena
+ *
+ * y siempre con vaciar_salida, antes de cada escribir directo y antes
+ * de terminar_proceso, tambien al volver de main.
+ *
+ * Las instancias de un mismo programa comparten la imagen, y con ella
+ * las variables de la biblioteca, asi que cada proceso ocupa el buffer
+ * de su pid modulo NUM_SALIDAS, que se lee de la pagina de datos del
+ * nucleo sin llamada. La tabla de procesos puede ser mucho mayor, y si
+ * el buffer ya es de otro proceso vivo se escribe sin buffer.
+ *
+ * El dueno se identifica por su numero de creacion, que no se repite
+ * aunque se reutilice el pid. Si un proceso muere sin terminar_salida,
+ * por ejemplo por una excepcion, lo que quede en su buffer lo escribe
+ * el siguiente que lo ocupa, y si nadie lo ocupa, el primer proceso
+ * del programa que termine.
+ *
+ */
+
+#include <stdio.h>	/* vsnprintf */
+#include <stdarg.h>
+#include <string.h>
+#include "llamsis.h"
+#include "servicios.h"
+
+int llamsis(int llamada, int nargs, ... /* args */);
+
+#define NUM_SALIDAS 64
+
+/* dueno: numero de creacion y pid en una palabra, para ocuparlo con
+   una sola operacion atomica */
+#define BITS_PID 16
+#define DUENO(serie, pid) (((serie) << BITS_PID) | (pid))
+#define PID_DUENO(d) ((int)((d) & ((1UL << BITS_PID) - 1)))
+#define SERIE_DUENO(d) ((d) >> BITS_PID)
+
+typedef struct{
+	unsigned long dueno;	/* DUENO del proceso que lo usa, 0 si libre */
+	int modo;
+	unsigned int usados;
+	char datos[TAM_SALIDA];
+} buffer_salida;
+
+static buffer_salida salidas[NUM_SALIDAS];
+
+/* vuelca el buffer sin pasar por el escribir de la biblioteca, que
+   vacia antes el buffer */
+static void volcar(buffer_salida *s){
+	if (s->usados > 0)
+		llamsis(ESCRIBIR, 2, (long)s->datos, (long)s->usados);
+	s->usados = 0;
+}
+
+/* ocupa el buffer si su dueno ya no existe, escribiendo lo que dejo */
+static int recoger(buffer_salida *s, unsigned long dueno, unsigned long yo){
+	if (dueno != 0 && leer_serie(PID_DUENO(dueno)) == SERIE_DUENO(dueno))
+		return 0;
+	if (!__sync_bool_compare_and_swap(&s->dueno, dueno, yo))
+		return 0;
+	if (dueno != 0)
+		volcar(s);
+	return 1;
+}
+
+/* buffer del proceso, que lo ocupa si esta libre o su dueno ya no
+   existe; NULL si es de otro proceso vivo */
+static buffer_salida *salida_actual(){
+	int pid = get_pid();
+	unsigned long yo = DUENO(leer_serie(pid), pid);
+	buffer_salida *s = &salidas[pid % NUM_SALIDAS];
+	unsigned long dueno = s->dueno;
+
+	if (dueno == yo)
+		return s;
+	if (!recoger(s, dueno, yo))
+		return NULL;
+	s->modo = SALIDA_LINEA;
+	s->usados = 0;
+	return s;
+}
+
+int vaciar_salida(){
+	buffer_salida *s = salida_actual();
+
+	if (s)
+		volcar(s);
+	return 0;
+}
+
+int fijar_modo_salida(int modo){
+	buffer_salida *s = salida_actual();
+
+	if (s == NULL || (modo != SALIDA_LINEA && modo != SALIDA_SIN_BUFFER &&
+			modo != SALIDA_COMPLETA))
+		return -1;
+	volcar(s);
+	s->modo = modo;
+	return 0;
+}
+
+/* vacia el buffer y lo deja libre para otro proceso; escribe tambien
+   lo que dejaron los procesos del programa que murieron sin llamarla */
+void terminar_salida(){
+	buffer_salida *s = salida_actual();
+	int pid = get_pid();
+	unsigned long yo = DUENO(leer_serie(pid), pid);
+	unsigned long dueno;
+	int i;
+
+	if (s){
+		volcar(s);
+		s->dueno = 0;
+	}
+	for (i = 0; i < NUM_SALIDAS; i++){
+		dueno = salidas[i].dueno;
+		if (dueno != 0 && recoger(&salidas[i], dueno, yo))
+			salidas[i].dueno = 0;
+	}
+}
+
+int imprimirf(const char *formato, ...){
+	buffer_salida *s = salida_actual();
+	char texto[TAM_SALIDA];
+	va_list ap;
+	int longi;
+
+	va_start(ap, formato);
+	longi = vsnprintf(texto, sizeof(texto), formato, ap);
+	va_end(ap);
+	if (longi < 0)
+		return longi;
+	if (longi >= (int)sizeof(texto))
+		longi = sizeof(texto) - 1;	/* se trunca */
+
+	if (s == NULL || s->modo == SALIDA_SIN_BUFFER){
+		llamsis(ESCRIBIR, 2, (long)texto, (long)longi);
+		return longi;
+	}
+
+	if (s->usados + longi > TAM_SALIDA)
+		volcar(s);
+	memcpy(&s->datos[s->usados], texto, longi);
+	s->usados += longi;
+
+	if (s->usados == TAM_SALIDA ||
+			(s->modo == SALIDA_LINEA && memchr(texto, '\n', longi)))
+		volcar(s);
+	return longi;
+}
@@ -16,6 +16,7 @@
  *
  */
 
+#include <stdarg.h>
 #include "llamsis.h"
 #include "servicios.h"
 
@@ -26,6 +27,17 @@
 
 int llamsis(int llamada, int nargs, ... /* args */);
 
+/* Pagina de datos del nucleo; se pide en la primera consulta y desde
+   entonces se lee sin llamadas. El nucleo la cambia por su cuenta, de
+   ahi el volatile */
+static const volatile datos_nucleo *datos = 0;
+
+static const volatile datos_nucleo *pagina(){
+	if (datos == 0)
+		llamsis(PAGINA_DATOS_NUCLEO, 1, (long)&datos);
+	return datos;
+}
+
 
 /*
  *
@@ -38,13 +50,15 @@ int crear_proceso(char *prog){
 	return llamsis(CREAR_PROCESO, 1, (long)prog);
 }
 int terminar_proceso(){
+	terminar_salida();	/* no se pierde la salida con buffer */
 	return llamsis(TERMINAR_PROCESO, 0);
 }
 int escribir(char *texto, unsigned int longi){
+	vaciar_salida();	/* mantiene el orden con la salida con buffer */
 	return llamsis(ESCRIBIR, 2, (long)texto, (long)longi);
 }
 int get_pid(){
-        return llamsis(GET_PID, 0); /* no recibe argumentos de entrada*/
+        return pagina()->pid; /* sin llamada, de la pagina de datos */
 }
 int dormir(unsigned int segundos){
         /*  pasamos segundos como long ya que las demas hacen lo mismo */
@@ -54,5 +68,116 @@ int fijar_prio(unsigned int prio){
     return llamsis(FIJAR_PRIO, 1, (long)prio);
 }
 int get_ppid(){
-    return llamsis(GET_PPID, 0);
+    return pagina()->ppid;
+}
+int fijar_tiempo_real(unsigned int periodo, unsigned int presupuesto,
+		unsigned int plazo){
+    return llamsis(FIJAR_TIEMPO_REAL, 3, (long)periodo, (long)presupuesto,
+		(long)plazo);
+}
+int fallos_plazo(int pid){
+    return llamsis(FALLOS_PLAZO, 1, (long)pid);
+}
+int dormir_ms(unsigned int milisegundos){
+    return llamsis(DORMIR_MS, 1, (long)milisegundos);
+}
+int dormir_hasta(unsigned long tick){
+    return llamsis(DORMIR_HASTA, 1, (long)tick);
+}
+int leer_uso(uso_proceso *uso){
+    return llamsis(LEER_USO, 1, (long)uso);
+}
+int leer_latencias(unsigned int prioridad, histograma_latencia *h){
+    return llamsis(LEER_LATENCIAS, 2, (long)prioridad, (long)h);
+}
+int volcar_traza(){
+    return llamsis(VOLCAR_TRAZA, 0);
+}
+int leer_reloj(reloj_monotono *reloj){
+    return llamsis(LEER_RELOJ, 1, (long)reloj);
+}
+int pagina_datos_nucleo(const datos_nucleo **pagina){
+    return llamsis(PAGINA_DATOS_NUCLEO, 1, (long)pagina);
+}
+int lote_llamadas(peticion_lote *lote, int num){
+    return llamsis(LOTE, 2, (long)lote, (long)num);
+}
+int leer_caracter(){
+    return llamsis(LEER_CARACTER, 0);
+}
+int leer_linea(char *buf, int max){
+    return llamsis(LEER_LINEA, 2, (long)buf, (long)max);
+}
+int leer(char *buf, int n){
+    return llamsis(LEER, 2, (long)buf, (long)n);
+}
+int fijar_modo_terminal(int modo, unsigned int min,
+		unsigned int milisegundos){
+    return llamsis(FIJAR_MODO_TERMINAL, 3, (long)modo, (long)min,
+		(long)milisegundos);
+}
+
+/*
+ *
+ * Consultas que leen la pagina de datos del nucleo sin llamada
+ *
+ */
+
+unsigned long leer_ticks(){
+    return pagina()->ticks;
+}
+int leer_prio(){
+    return pagina()->prioridad;
+}
+/* numero de creacion del proceso vivo con ese pid, 0 si no hay ninguno;
+   no se repite aunque se reutilice el pid */
+unsigned long leer_serie(int pid){
+    return pid < 0 ? 0 : pagina()->series[pid];
+}
+
+/*
+ *
+ * Funciones de apoyo a los lotes de llamadas
+ *
+ */
+
+/* rellena una peticion con la llamada y sus nargs argumentos, que se
+   pasan como long igual que a llamsis */
+void preparar_peticion(peticion_lote *p, int servicio, int nargs, ...){
+    va_list ap;
+    int i;
+
+    p->servicio = servicio;
+    p->resultado = 0;
+    va_start(ap, nargs);
+    for (i = 0; i < ARGS_LOTE; i++)
+        p->args[i] = (i < nargs) ? va_arg(ap, long) : 0;
+    va_end(ap);
+}
+
+/* ejecuta todo el lote: las peticiones que pueden bloquear o terminar,
+   que el nucleo no admite en lotes, se hacen sueltas. Como en escribir
+   y terminar_proceso, antes se vacia la salida con buffer */
+int ejecutar_lote(peticion_lote *lote, int num){
+    peticion_lote *p;
+    int hechas = 0, res;
+
+    while (hechas < num){
+        vaciar_salida();
+        res = lote_llamadas(lote + hechas, num - hechas);
+        if (res < 0)
+            return -1;
+        hechas += res;
+        if (hechas < num){
+            p = &lote[hechas];
+            if (p->servicio == TERMINAR_PROCESO)
+                terminar_salida();
+            else
+                vaciar_salida();
+            p->resultado = llamsis(p->servicio, ARGS_LOTE, p->args[0],
+                p->args[1], p->args[2], p->args[3], p->args[4]);
+            hechas++;
+        }
+    }
+    return hechas;
 }
@@ -0,0 +1,40 @@
+/*
+ * usuario/periodico.c
+ *
+ */
+
+/*
+ * Programa de usuario que se registra como tarea de tiempo real y
+ * consume CPU en cada trabajo. Los primeros trabajos caben en el
+ * presupuesto y los ultimos lo agotan y pierden su plazo.
+ */
+
+#include "servicios.h"
+
+#define PERIODO 50	/* en ticks */
+#define PRESUPUESTO 10
+#define PLAZO 40
+#define TRABAJOS 6
+#define CARGA 10000000
+
+int main(){
+    int i, inicio;
+    long j;
+
+    printf("Periodico: comienza\n");
+    if (fijar_tiempo_real(PERIODO, PRESUPUESTO, PLAZO) < 0){
+        printf("Periodico: rechazado\n");
+        return 0;
+    }
+    /* un tick ya pasado no duerme y devuelve el actual */
+    inicio = dormir_hasta(0);
+    for (i = 0; i < TRABAJOS; i++){
+        /* la carga crece con cada trabajo */
+        for (j = 0; j < CARGA * i * i; j++);
+        /* al bloquearse acaba el trabajo; espera al siguiente periodo */
+        dormir_hasta(inicio + (i + 1) * PERIODO);
+    }
+    printf("Periodico: %d plazos perdidos\n", fallos_plazo(get_pid()));
+    printf("Periodico: termina\n");
+    return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * usuario/prueba_crear.c
+ *
+ */
+
+/*
+ * Prueba de rendimiento: creacion y terminacion de procesos. En cada una
+ * de RONDAS crea HIJOS procesos, instancias de este mismo programa, que
+ * terminan enseguida, y duerme hasta que han terminado todos. Se mide
+ * desde el principio de la ronda hasta que el ultimo hijo empieza a
+ * ejecutar, lo que incluye crear los hijos, ponerlos en marcha y la
+ * terminacion de todos salvo el ultimo, pero no el tiempo ocioso que
+ * pasa hasta que despierta el padre. Los hijos avisan con variables
+ * comunes, que comparten porque comparten la imagen.
+ */
+
+#include "servicios.h"
+
+#define RONDAS 50
+#define HIJOS 10
+
+/* comunes al padre y los hijos */
+static volatile int vivos = 0;
+static volatile unsigned long us_fin;
+
+int main(){
+    int i, j, creados = 0, fallos = 0;
+    unsigned long us = 0, us_inicio;
+    reloj_monotono r;
+
+    /* el proceso inicial ocupa siempre la entrada 0 de la tabla */
+    if (get_pid() != 0){
+        leer_reloj(&r);
+        us_fin = r.us;
+        __sync_fetch_and_sub(&vivos, 1);
+        return 0;
+    }
+
+    for (i = 0; i < RONDAS; i++){
+        leer_reloj(&r);
+        us_inicio = us_fin = r.us;
+        for (j = 0; j < HIJOS; j++){
+            /* segun la politica el hijo puede ejecutar antes de volver */
+            __sync_fetch_and_add(&vivos, 1);
+            if (crear_proceso("prueba_crear") < 0){
+                __sync_fetch_and_sub(&vivos, 1);
+                fallos++;
+            }
+            else
+                creados++;
+        }
+        while (vivos > 0)
+            dormir_ms(1);
+        us += us_fin - us_inicio;
+    }
+
+    printf("RESULTADO prueba_crear procesos=%d fallos=%d us=%lu "
+        "us_proceso=%lu\n", creados, fallos, us,
+        creados ? us / creados : 0);
+    return 0;
+}
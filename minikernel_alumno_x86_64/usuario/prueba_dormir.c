@@ -0,0 +1,44 @@
+/*
+ * usuario/prueba_dormir.c
+ *
+ */
+
+/*
+ * Prueba de rendimiento: tormenta de procesos dormidos. El proceso
+ * inicial crea HIJOS copias de este programa que duermen SUENOS veces
+ * plazos cortos y cuentan los ticks de retraso al despertar; al final
+ * el inicial muestra la latencia de despertar del nucleo.
+ */
+
+#include "servicios.h"
+
+#define HIJOS 8
+#define SUENOS 50
+
+int main(){
+    int i, objetivo, retraso = 0, pid;
+    histograma_latencia h;
+
+    /* el proceso inicial ocupa siempre la entrada 0 de la tabla */
+    if (get_pid() == 0){
+        for (i = 0; i < HIJOS; i++)
+            crear_proceso("prueba_dormir");
+        /* da tiempo a que terminen todos */
+        dormir_hasta(dormir_hasta(0) + SUENOS * 6 + 20);
+        leer_latencias(LATENCIA_GLOBAL, &h);
+        printf("RESULTADO prueba_dormir hijos=%d suenos=%d "
+            "despertares=%d latencia_max_us=%d\n", HIJOS, SUENOS, h.num,
+            h.maximo);
+        return 0;
+    }
+
+    pid = get_pid();
+    for (i = 0; i < SUENOS; i++){
+        /* plazos de 1 a 5 ticks para que coincidan varios */
+        objetivo = dormir_hasta(0) + 1 + (pid + i) % 5;
+        retraso += dormir_hasta(objetivo) - objetivo;
+    }
+    printf("RESULTADO prueba_dormir pid=%d retraso_ticks=%d\n", pid,
+        retraso);
+    return 0;
+}
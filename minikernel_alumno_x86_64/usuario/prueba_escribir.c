@@ -0,0 +1,36 @@
+/*
+ * usuario/prueba_escribir.c
+ *
+ */
+
+/*
+ * Prueba de rendimiento: caudal de escritura en la consola, con una
+ * llamada escribir por linea y con printf con buffer completo
+ */
+
+#include "servicios.h"
+
+#define LINEAS 2000
+
+static char linea[] =
+    "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrs\n";
+
+int main(){
+    int i;
+    reloj_monotono r0, r1, r2;
+
+    leer_reloj(&r0);
+    for (i = 0; i < LINEAS; i++)
+        escribir(linea, sizeof(linea) - 1);
+    leer_reloj(&r1);
+    fijar_modo_salida(SALIDA_COMPLETA);
+    for (i = 0; i < LINEAS; i++)
+        printf("%s", linea);
+    vaciar_salida();
+    leer_reloj(&r2);
+
+    printf("RESULTADO prueba_escribir lineas=%d bytes=%d us_escribir=%d "
+        "us_printf=%d\n", LINEAS, LINEAS * (int)(sizeof(linea) - 1),
+        (int)(r1.us - r0.us), (int)(r2.us - r1.us));
+    return 0;
+}
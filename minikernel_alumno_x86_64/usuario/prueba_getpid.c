@@ -0,0 +1,30 @@
+/*
+ * usuario/prueba_getpid.c
+ *
+ */
+
+/*
+ * Prueba de rendimiento: coste de get_pid, que se lee de la pagina de
+ * datos del nucleo, frente al de una llamada al sistema minima como
+ * leer_reloj
+ */
+
+#include "servicios.h"
+
+#define LLAMADAS 100000
+
+int main(){
+    int i;
+    reloj_monotono r0, r1, r2;
+
+    leer_reloj(&r0);
+    for (i = 0; i < LLAMADAS; i++)
+        get_pid();
+    leer_reloj(&r1);
+    for (i = 0; i < LLAMADAS; i++)
+        leer_reloj(&r2);
+
+    printf("RESULTADO prueba_getpid llamadas=%d us_pagina=%d us_llamada=%d\n",
+        LLAMADAS, (int)(r1.us - r0.us), (int)(r2.us - r1.us));
+    return 0;
+}
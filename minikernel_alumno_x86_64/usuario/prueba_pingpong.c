@@ -0,0 +1,60 @@
+/*
+ * usuario/prueba_pingpong.c
+ *
+ */
+
+/*
+ * Prueba de rendimiento: cambios de contexto entre dos procesos. Como
+ * no hay mecanismos de sincronizacion, los dos se duermen hasta el mismo
+ * tick: al despertar ejecuta uno, y al volver a dormirse el nucleo pasa
+ * directamente al otro. Ese cambio se mide con leer_reloj entre la
+ * ultima lectura antes de dormir y la primera al despertar, que se
+ * comparten porque las dos instancias del programa comparten la imagen.
+ * El proceso inicial crea al segundo con este mismo programa.
+ */
+
+#include "servicios.h"
+
+#define RONDAS 200
+
+/* comunes a las dos instancias */
+static volatile unsigned long tick_inicio = 0;
+static volatile int pid_salida = -1;		/* ultimo en dormirse */
+static volatile unsigned long tick_salida, us_salida;
+static volatile unsigned long cambios = 0, us_cambios = 0;
+
+int main(){
+    int i, pid, inicial;
+    reloj_monotono r;
+
+    /* el proceso inicial ocupa siempre la entrada 0 de la tabla */
+    pid = get_pid();
+    inicial = (pid == 0);
+    if (inicial){
+        tick_inicio = leer_ticks() + 2;
+        crear_proceso("prueba_pingpong");
+    }
+
+    for (i = 0; i < RONDAS; i++){
+        leer_reloj(&r);
+        pid_salida = pid;
+        tick_salida = r.ticks;
+        us_salida = r.us;
+        dormir_hasta(tick_inicio + i);
+        leer_reloj(&r);
+        /* si el otro se acaba de dormir en este tick, el nucleo ha
+           pasado de el a este proceso sin nada en medio */
+        if (pid_salida != pid && tick_salida == r.ticks){
+            cambios++;
+            us_cambios += r.us - us_salida;
+        }
+    }
+
+    if (inicial){
+        dormir_hasta(tick_inicio + RONDAS + 1);	/* termina el otro */
+        printf("RESULTADO prueba_pingpong rondas=%d cambios=%lu us=%lu "
+            "ns_cambio=%lu\n", RONDAS, cambios, us_cambios,
+            cambios ? us_cambios * 1000 / cambios : 0);
+    }
+    return 0;
+}
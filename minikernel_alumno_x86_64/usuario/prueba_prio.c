@@ -0,0 +1,40 @@
+/*
+ * usuario/prueba_prio.c
+ *
+ */
+
+/*
+ * Prueba de rendimiento: mezcla de procesos de calculo con distinta
+ * prioridad. El proceso inicial crea HIJOS copias de este programa y
+ * cada una fija una prioridad segun su pid, hace el mismo calculo y
+ * muestra su uso de UCP, lo que ha esperado listo y cuando acaba.
+ */
+
+#include "servicios.h"
+
+#define HIJOS 4
+#define CARGA 200000000
+
+int main(){
+    int i, prio, t0;
+    long j;
+    uso_proceso uso;
+
+    /* el proceso inicial ocupa siempre la entrada 0 de la tabla */
+    if (get_pid() == 0){
+        for (i = 0; i < HIJOS; i++)
+            crear_proceso("prueba_prio");
+        return 0;
+    }
+
+    prio = 10 + (get_pid() % HIJOS) * 10;
+    fijar_prio(prio);
+    t0 = dormir_hasta(0);
+    for (j = 0; j < CARGA; j++);
+    leer_uso(&uso);
+    printf("RESULTADO prueba_prio pid=%d prio=%d ticks_usuario=%d "
+        "ticks_espera=%d ticks=%d\n", get_pid(), prio,
+        uso.propio.ticks_usuario, uso.propio.ticks_espera,
+        dormir_hasta(0) - t0);
+    return 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * usuario/teclas.c
+ *
+ */
+
+/*
+ * Programa de usuario que lee el terminal en modo crudo con leer,
+ * mostrando los codigos que recibe en cada lectura, o que ha vencido el
+ * plazo si no llega nada, hasta que se pulsa 'q'. Con minimo 1 y plazo
+ * PLAZO_MS, leer vuelve en cuanto hay un caracter con todos los que han
+ * llegado hasta entonces, o con 0 si vence el plazo sin ninguno. Como
+ * los caracteres llegan de uno en uno, lo que se pega de una vez puede
+ * repartirse entre varias lecturas.
+ */
+
+#include "servicios.h"
+
+#define TAM_BUF 64
+#define PLAZO_MS 2000
+
+int main(){
+    char buf[TAM_BUF];
+    int i, n, fin = 0;
+
+    printf("teclas: pulse teclas, 'q' para terminar\n");
+    fijar_modo_terminal(TERMINAL_CRUDO, 1, PLAZO_MS);
+    while (!fin){
+        n = leer(buf, TAM_BUF);
+        if (n == 0){
+            printf("teclas: plazo vencido\n");
+            continue;
+        }
+        printf("teclas: %d:", n);
+        for (i = 0; i < n; i++){
+            printf(" %d", buf[i]);
+            if (buf[i] == 'q')
+                fin = 1;
+        }
+        printf("\n");
+    }
+    fijar_modo_terminal(TERMINAL_CANONICO, 0, 0);
+    printf("teclas: termina\n");
+    return 0;
+}